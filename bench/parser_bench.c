@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../common/weather_core.h"
+
+/**
+ * Parser microbenchmark
+ *
+ *   parser_bench [rows] [reps] [--warmup N] [--json FILE] [--commit ID]
+ *
+ * Times each stage of the row parser on rows held in memory, so disk and
+ * page cache never enter the numbers:
+ *
+ *   get_field   tokenizing the date, avg_temp and precipitation fields
+ *   get_month   decoding the month from pre-extracted dates
+ *   atof        converting pre-extracted temperature and precipitation
+ *   update      aggregate_record, the CityStats update, on pre-parsed rows
+ *   row         accumulate_record end to end (the sum of the above)
+ *
+ * Every stage runs `warmup` untimed then `reps` timed passes over all rows.
+ * The report gives the median pass and its spread (median absolute
+ * deviation, min, max). GB/s and rows/s are relative to the CSV bytes the
+ * rows occupy, so stages can be compared with each other and with the
+ * end-to-end row time. Results are also written as JSON for tracking per
+ * commit.
+ */
+
+#define DEFAULT_ROWS 200000
+#define DEFAULT_REPS 15
+#define DEFAULT_WARMUP 3
+#define ROWS_PER_CITY 3650
+#define DATE_LEN 32
+#define NUM_LEN 16
+
+static const char* seasons[12] = {
+    "Winter", "Winter", "Spring", "Spring", "Spring", "Summer",
+    "Summer", "Summer", "Autumn", "Autumn", "Autumn", "Winter"};
+
+// Rows and their pre-extracted fields; each stage reads only its input
+typedef struct {
+    long rows;
+    size_t bytes;             // CSV bytes of all rows
+    char* text;               // NUL-terminated rows, back to back
+    size_t* line_off;
+    char (*dates)[DATE_LEN];
+    char (*temps)[NUM_LEN];
+    char (*precips)[NUM_LEN];
+    ParsedRecord* recs;       // rows as parse_record leaves them
+    int cities;
+    CityStats* stats;
+} BenchData;
+
+typedef struct {
+    const char* name;
+    double median;
+    double mad;
+    double min;
+    double max;
+} StageResult;
+
+// Defeats dead-code elimination of the timed loops
+static volatile double sink;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long next_u64(unsigned long long* state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double next_unit(unsigned long long* state) {
+    return (next_u64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Rows in the data/cities schema, 2% of measurements empty
+static int build_rows(BenchData* b, long rows) {
+    b->rows = rows;
+    b->cities = (int)((rows + ROWS_PER_CITY - 1) / ROWS_PER_CITY);
+    b->text = malloc(rows * 128);
+    b->line_off = malloc(rows * sizeof(size_t));
+    b->dates = malloc(rows * sizeof(*b->dates));
+    b->temps = malloc(rows * sizeof(*b->temps));
+    b->precips = malloc(rows * sizeof(*b->precips));
+    b->recs = malloc(rows * sizeof(ParsedRecord));
+    b->stats = malloc(b->cities * sizeof(CityStats));
+    if (!b->text || !b->line_off || !b->dates || !b->temps || !b->precips || !b->recs || !b->stats) {
+        return -1;
+    }
+
+    unsigned long long rng = 42;
+    size_t off = 0;
+    for (long r = 0; r < rows; r++) {
+        int city = (int)(r / ROWS_PER_CITY);
+        int day = (int)(r % ROWS_PER_CITY);
+        int year = 1990 + day / 365, month = (day % 365) / 31 % 12, mday = day % 28 + 1;
+        double avg = -10.0 + 40.0 * next_unit(&rng);
+        double precip = next_unit(&rng) < 0.4 ? 20.0 * next_unit(&rng) : 0.0;
+
+        char t[NUM_LEN] = "", p[NUM_LEN] = "";
+        if (next_unit(&rng) >= 0.02) snprintf(t, sizeof(t), "%.1f", avg);
+        if (next_unit(&rng) >= 0.02) snprintf(p, sizeof(p), "%.1f", precip);
+
+        int len = snprintf(b->text + off, 128,
+                           "S%d,City_%04d,%04d-%02d-%02d 00:00:00,%s,%s,%.1f,%.1f,%s,,%.0f,%.1f,,%.1f,\n",
+                           city, city, year, month + 1, mday, seasons[month], t, avg - 4.0, avg + 4.0, p,
+                           360.0 * next_unit(&rng), 30.0 * next_unit(&rng), 1000.0 + 30.0 * next_unit(&rng));
+        b->line_off[r] = off;
+        off += len + 1;
+
+        get_field(b->text + b->line_off[r], FIELD_DATE, b->dates[r], DATE_LEN);
+        strcpy(b->temps[r], t);
+        strcpy(b->precips[r], p);
+        parse_record(b->text + b->line_off[r], &b->recs[r], 0);
+        b->bytes += len;
+    }
+    return 0;
+}
+
+static void stage_get_field(BenchData* b) {
+    char date[DATE_LEN], buf[64];
+    double check = 0;
+    for (long r = 0; r < b->rows; r++) {
+        const char* line = b->text + b->line_off[r];
+        get_field(line, FIELD_DATE, date, sizeof(date));
+        get_field(line, FIELD_AVG_TEMP, buf, sizeof(buf));
+        check += buf[0];
+        get_field(line, FIELD_PRECIP, buf, sizeof(buf));
+        check += buf[0] + date[6];
+    }
+    sink = check;
+}
+
+static void stage_get_month(BenchData* b) {
+    long check = 0;
+    for (long r = 0; r < b->rows; r++) check += get_month(b->dates[r]);
+    sink = check;
+}
+
+static void stage_atof(BenchData* b) {
+    double check = 0;
+    for (long r = 0; r < b->rows; r++) {
+        if (b->temps[r][0] != '\0') check += atof(b->temps[r]);
+        if (b->precips[r][0] != '\0') check += atof(b->precips[r]);
+    }
+    sink = check;
+}
+
+static void stage_update(BenchData* b) {
+    for (int c = 0; c < b->cities; c++) init_city_stats(&b->stats[c]);
+    for (long r = 0; r < b->rows; r++) {
+        aggregate_record(&b->stats[r / ROWS_PER_CITY], &b->recs[r], NULL, 0);
+    }
+    sink = b->stats[0].temp_sum;
+}
+
+static void stage_row(BenchData* b) {
+    for (int c = 0; c < b->cities; c++) init_city_stats(&b->stats[c]);
+    for (long r = 0; r < b->rows; r++) {
+        accumulate_record(&b->stats[r / ROWS_PER_CITY], b->text + b->line_off[r], NULL, 0);
+    }
+    sink = b->stats[0].temp_sum;
+}
+
+static int compare_double(const void* pa, const void* pb) {
+    double a = *(const double*)pa, b = *(const double*)pb;
+    return (a > b) - (a < b);
+}
+
+static double median_of(double* v, int n) {
+    qsort(v, n, sizeof(double), compare_double);
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+static StageResult run_stage(const char* name, void (*stage)(BenchData*), BenchData* b,
+                             int warmup, int reps, double* times) {
+    for (int i = 0; i < warmup; i++) stage(b);
+    for (int i = 0; i < reps; i++) {
+        double t0 = now_sec();
+        stage(b);
+        times[i] = now_sec() - t0;
+    }
+
+    StageResult res;
+    res.name = name;
+    res.median = median_of(times, reps);
+    res.min = times[0];
+    res.max = times[reps - 1];
+    for (int i = 0; i < reps; i++) {
+        times[i] = times[i] > res.median ? times[i] - res.median : res.median - times[i];
+    }
+    res.mad = median_of(times, reps);
+    return res;
+}
+
+int main(int argc, char* argv[]) {
+    long rows = DEFAULT_ROWS;
+    int reps = DEFAULT_REPS;
+    int warmup = DEFAULT_WARMUP;
+    const char* json_path = NULL;
+    const char* commit = "unknown";
+
+    int pos = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--commit") == 0 && i + 1 < argc) {
+            commit = argv[++i];
+        } else if (argv[i][0] != '-' && pos < 2) {
+            if (pos++ == 0) rows = atol(argv[i]);
+            else reps = atoi(argv[i]);
+        } else {
+            printf("Usage: %s [rows] [reps] [--warmup N] [--json FILE] [--commit ID]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rows < 1 || reps < 1 || warmup < 0) {
+        fprintf(stderr, "rows and reps must be positive\n");
+        return 1;
+    }
+
+    BenchData b;
+    memset(&b, 0, sizeof(b));
+    double* times = malloc(reps * sizeof(double));
+    if (!times || build_rows(&b, rows) != 0) {
+        fprintf(stderr, "malloc failed for %ld rows\n", rows);
+        return 1;
+    }
+
+    struct {
+        const char* name;
+        void (*fn)(BenchData*);
+    } stages[] = {
+        {"get_field", stage_get_field},
+        {"get_month", stage_get_month},
+        {"atof", stage_atof},
+        {"update", stage_update},
+        {"row", stage_row},
+    };
+    int num_stages = (int)(sizeof(stages) / sizeof(stages[0]));
+    StageResult results[8];
+
+    printf("Parser microbenchmark: %ld rows, %.1f MB, %d reps after %d warmup\n",
+           rows, b.bytes / 1e6, reps, warmup);
+    printf("%-12s %12s %10s %10s %10s %10s %14s\n", "Stage", "Median(ms)", "MAD(ms)", "Min(ms)",
+           "Max(ms)", "GB/s", "Mrows/s");
+    printf("--------------------------------------------------------------------------------\n");
+    for (int s = 0; s < num_stages; s++) {
+        StageResult* r = &results[s];
+        *r = run_stage(stages[s].name, stages[s].fn, &b, warmup, reps, times);
+        printf("%-12s %12.3f %10.3f %10.3f %10.3f %10.3f %14.2f\n", r->name, r->median * 1e3,
+               r->mad * 1e3, r->min * 1e3, r->max * 1e3, b.bytes / r->median / 1e9,
+               rows / r->median / 1e6);
+    }
+
+    if (json_path) {
+        FILE* fp = fopen(json_path, "w");
+        if (!fp) {
+            perror(json_path);
+            return 1;
+        }
+        fprintf(fp, "{\n  \"benchmark\": \"parser\",\n  \"commit\": \"%s\",\n", commit);
+        fprintf(fp, "  \"rows\": %ld,\n  \"bytes\": %zu,\n  \"reps\": %d,\n  \"warmup\": %d,\n",
+                rows, b.bytes, reps, warmup);
+        fprintf(fp, "  \"stages\": [\n");
+        for (int s = 0; s < num_stages; s++) {
+            const StageResult* r = &results[s];
+            fprintf(fp, "    {\"name\": \"%s\", \"median_s\": %.9f, \"mad_s\": %.9f, \"min_s\": %.9f, "
+                        "\"max_s\": %.9f, \"gb_per_s\": %.4f, \"rows_per_s\": %.0f}%s\n",
+                    r->name, r->median, r->mad, r->min, r->max, b.bytes / r->median / 1e9,
+                    rows / r->median, s + 1 < num_stages ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+        fclose(fp);
+        printf("Results saved to %s\n", json_path);
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef WEATHER_ARENA_H
+#define WEATHER_ARENA_H
+
+/**
+ * Bump arena for hot-path scratch memory
+ *
+ * Each worker (thread or rank) owns one arena. Allocations only move a
+ * pointer forward; arena_reset() rewinds it so the next file reuses the
+ * same pages. Backing memory is one anonymous mapping aligned to 2 MB and
+ * advised for transparent huge pages, so a worker's scratch normally sits
+ * in a single TLB entry. Pages are only committed when first touched.
+ *
+ * Header-only so every backend (including the CUDA host path) can use it.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define ARENA_ALIGN 64
+#define ARENA_HUGE_PAGE (2UL * 1024 * 1024)
+
+typedef struct {
+    char* map;          // raw mapping (for munmap)
+    size_t map_size;
+    char* base;         // 2 MB aligned start
+    size_t size;
+    size_t used;
+    size_t peak;
+    long allocs;        // bump allocations served
+    long resets;
+    int huge;           // MADV_HUGEPAGE accepted
+} Arena;
+
+// Reserve at least `size` bytes. Returns 0 on success, -1 on failure.
+static inline int arena_init(Arena* a, size_t size) {
+    size = (size + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+    if (size == 0) size = ARENA_HUGE_PAGE;
+
+    // Over-map by one huge page so the usable range can be 2 MB aligned
+    size_t map_size = size + ARENA_HUGE_PAGE;
+    void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) {
+        a->map = a->base = NULL;
+        a->size = a->map_size = 0;
+        return -1;
+    }
+
+    a->map = (char*)map;
+    a->map_size = map_size;
+    a->base = (char*)(((size_t)a->map + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1));
+    a->size = size;
+    a->used = 0;
+    a->peak = 0;
+    a->allocs = 0;
+    a->resets = 0;
+#ifdef MADV_HUGEPAGE
+    a->huge = madvise(a->base, a->size, MADV_HUGEPAGE) == 0;
+#else
+    a->huge = 0;
+#endif
+    return 0;
+}
+
+// 64-byte aligned bump allocation; NULL when the reservation is exhausted
+static inline void* arena_alloc(Arena* a, size_t bytes) {
+    size_t start = (a->used + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1);
+    if (start + bytes > a->size) return NULL;
+
+    a->used = start + bytes;
+    if (a->used > a->peak) a->peak = a->used;
+    a->allocs++;
+    return a->base + start;
+}
+
+// Drop every allocation (reset-per-file: call before each file)
+static inline void arena_reset(Arena* a) {
+    a->used = 0;
+    a->resets++;
+}
+
+// Rewind to an earlier arena_mark(), keeping allocations made before it
+static inline size_t arena_mark(const Arena* a) {
+    return a->used;
+}
+
+static inline void arena_reset_to(Arena* a, size_t mark) {
+    a->used = mark;
+    a->resets++;
+}
+
+static inline void arena_free(Arena* a) {
+    if (a->map) munmap(a->map, a->map_size);
+    a->map = a->base = NULL;
+    a->size = a->used = 0;
+}
+
+// Peak resident set size of this process in KB
+static inline long peak_rss_kb(void) {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+    return ru.ru_maxrss;
+}
+
+// One-line allocation summary over a set of arenas
+static inline void print_arena_stats(const char* label, const Arena* arenas, int count) {
+    long allocs = 0, resets = 0;
+    size_t peak = 0;
+    int huge = 1;
+    for (int i = 0; i < count; i++) {
+        allocs += arenas[i].allocs;
+        resets += arenas[i].resets;
+        if (arenas[i].peak > peak) peak = arenas[i].peak;
+        if (!arenas[i].huge) huge = 0;
+    }
+    printf("%s arena allocations: %ld (%d arenas, %ld resets, peak %.1f KB, huge pages: %s)\n",
+           label, allocs, count, resets, peak / 1024.0, huge ? "yes" : "no");
+}
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef WEATHER_BENCH_H
+#define WEATHER_BENCH_H
+
+/**
+ * --bench N: repeated timing inside the binaries
+ *
+ * A backend runs its timed region `warmup` times untimed and then N times
+ * more, handing each wall time to bench_record(). bench_report() prints
+ * min, median, p90, mean and standard deviation. With --bench-baseline
+ * the serial backend stores its median (with the dataset it was measured
+ * on) and the parallel backends read it back to report speedup and
+ * efficiency in-process. --bench-out appends one row per invocation, as
+ * CSV or, for a .json file, as one JSON object per line, so scaling
+ * sweeps collect results without scraping stdout.
+ *
+ * Header-only so every backend can share it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BENCH_DEFAULT_WARMUP 1
+
+typedef struct {
+    int reps;              // timed repetitions, 0 = one normal run
+    int warmup;            // untimed repetitions first
+    const char* out;       // results file to append to (NULL = none)
+    const char* baseline;  // serial median: written by serial, read by the others
+    double* times;
+    int count;
+} BenchConfig;
+
+typedef struct {
+    double min;
+    double median;
+    double p90;
+    double mean;
+    double stddev;
+} BenchStats;
+
+static inline void bench_init(BenchConfig* b) {
+    memset(b, 0, sizeof(*b));
+    b->warmup = BENCH_DEFAULT_WARMUP;
+}
+
+// Consume the --bench option at argv[*i]; returns 1 if it was one
+static inline int bench_parse_option(BenchConfig* b, int argc, char* argv[], int* i) {
+    if (*i + 1 >= argc) return 0;
+    if (strcmp(argv[*i], "--bench") == 0) b->reps = atoi(argv[++*i]);
+    else if (strcmp(argv[*i], "--bench-warmup") == 0) b->warmup = atoi(argv[++*i]);
+    else if (strcmp(argv[*i], "--bench-out") == 0) b->out = argv[++*i];
+    else if (strcmp(argv[*i], "--bench-baseline") == 0) b->baseline = argv[++*i];
+    else return 0;
+    return 1;
+}
+
+static inline void bench_usage(void) {
+    printf("  --bench <N>          time N runs after the warmup; report min/median/p90/stddev\n");
+    printf("  --bench-warmup <N>   untimed runs before --bench (default: %d)\n", BENCH_DEFAULT_WARMUP);
+    printf("  --bench-out <file>   append the statistics as a CSV row (JSON line for *.json)\n");
+    printf("  --bench-baseline <file>  serial: store the median; others: speedup against it\n");
+}
+
+// Runs of the timed region to perform; 0 if the buffer cannot be allocated
+static inline int bench_start(BenchConfig* b) {
+    if (b->reps <= 0) return 1;
+    if (b->warmup < 0) b->warmup = 0;
+    b->times = (double*)malloc(b->reps * sizeof(double));
+    if (!b->times) return 0;
+    b->count = 0;
+    return b->warmup + b->reps;
+}
+
+// Time of run `run` (0-based); warmup runs are dropped
+static inline void bench_record(BenchConfig* b, int run, double seconds) {
+    if (b->reps > 0 && run >= b->warmup) b->times[b->count++] = seconds;
+}
+
+static inline int bench_compare(const void* pa, const void* pb) {
+    double a = *(const double*)pa, b = *(const double*)pb;
+    return (a > b) - (a < b);
+}
+
+static inline void bench_stats(const BenchConfig* b, BenchStats* s) {
+    int n = b->count;
+    qsort(b->times, n, sizeof(double), bench_compare);
+    s->min = b->times[0];
+    s->median = n % 2 ? b->times[n / 2] : 0.5 * (b->times[n / 2 - 1] + b->times[n / 2]);
+    s->p90 = b->times[(int)ceil(0.9 * n) - 1];   // nearest rank
+
+    double sum = 0, sq = 0;
+    for (int i = 0; i < n; i++) sum += b->times[i];
+    s->mean = sum / n;
+    for (int i = 0; i < n; i++) sq += (b->times[i] - s->mean) * (b->times[i] - s->mean);
+    s->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0;
+}
+
+// Baseline file: "<median seconds> <cities> <data_dir>"
+static inline int bench_load_baseline(const char* path, const char* data_dir, long cities, double* median) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    char dir[4096];
+    long base_cities;
+    int ok = fscanf(f, "%lf %ld %4095[^\n]", median, &base_cities, dir) == 3;
+    fclose(f);
+    if (!ok) return -1;
+    if (base_cities != cities || strcmp(dir, data_dir) != 0) {
+        printf("Baseline %s was measured on %ld cities of %s, not this dataset\n", path, base_cities, dir);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Print the statistics and append them to --bench-out
+ *
+ * workers = threads * ranks (efficiency = speedup / workers). imbalance
+ * is the max/mean worker busy time of the last run, or <= 0 if the
+ * backend has no workers to compare. A baseline only applies to runs
+ * over the same directory and number of cities. Returns 0, or -1 if a
+ * file could not be written.
+ */
+static inline int bench_report(BenchConfig* b, const char* backend, const char* config, int workers,
+                               double imbalance, const char* data_dir, long cities) {
+    if (b->reps <= 0 || b->count == 0) return 0;
+
+    BenchStats s;
+    bench_stats(b, &s);
+
+    printf("\n========== BENCHMARK ==========\n");
+    printf("Backend: %s (%s), %d workers\n", backend, config, workers);
+    printf("Runs: %d timed after %d warmup\n", b->count, b->warmup);
+    printf("Min: %.4f s  Median: %.4f s  P90: %.4f s\n", s.min, s.median, s.p90);
+    printf("Mean: %.4f s  Stddev: %.4f s (%.1f%%)\n", s.mean, s.stddev,
+           s.mean > 0 ? 100.0 * s.stddev / s.mean : 0);
+
+    int rc = 0;
+    double speedup = 0, efficiency = 0;
+    if (b->baseline && strcmp(backend, "serial") == 0) {
+        FILE* f = fopen(b->baseline, "w");
+        if (f) {
+            fprintf(f, "%.9f %ld %s\n", s.median, cities, data_dir);
+            fclose(f);
+            printf("Baseline saved to %s\n", b->baseline);
+        } else {
+            perror(b->baseline);
+            rc = -1;
+        }
+    } else if (b->baseline) {
+        double base;
+        if (bench_load_baseline(b->baseline, data_dir, cities, &base) == 0 && s.median > 0) {
+            speedup = base / s.median;
+            efficiency = speedup / workers;
+            printf("Speedup vs serial baseline (%.4f s): %.3fx, efficiency %.1f%%\n",
+                   base, speedup, 100.0 * efficiency);
+        } else {
+            printf("No usable serial baseline in %s\n", b->baseline);
+        }
+    }
+
+    if (b->out) {
+        size_t len = strlen(b->out);
+        int json = len >= 5 && strcmp(b->out + len - 5, ".json") == 0;
+        FILE* f = fopen(b->out, "a");
+        if (!f) {
+            perror(b->out);
+            return -1;
+        }
+
+        char sp[32] = "", eff[32] = "", imb[32] = "";
+        if (speedup > 0) {
+            snprintf(sp, sizeof(sp), "%.4f", speedup);
+            snprintf(eff, sizeof(eff), "%.4f", efficiency);
+        }
+        if (imbalance > 0) snprintf(imb, sizeof(imb), "%.4f", imbalance);
+
+        if (json) {
+            fprintf(f, "{\"backend\": \"%s\", \"config\": \"%s\", \"workers\": %d, \"cities\": %ld, \"reps\": %d, "
+                       "\"warmup\": %d, \"min_s\": %.6f, \"median_s\": %.6f, \"p90_s\": %.6f, "
+                       "\"mean_s\": %.6f, \"stddev_s\": %.6f, \"speedup\": %s, \"efficiency\": %s, "
+                       "\"imbalance\": %s}\n",
+                    backend, config, workers, cities, b->count, b->warmup, s.min, s.median, s.p90, s.mean,
+                    s.stddev, sp[0] ? sp : "null", eff[0] ? eff : "null", imb[0] ? imb : "null");
+        } else {
+            fseek(f, 0, SEEK_END);
+            if (ftell(f) == 0) {
+                fprintf(f, "backend,config,workers,cities,reps,min_s,median_s,p90_s,mean_s,stddev_s,"
+                           "speedup,efficiency,imbalance\n");
+            }
+            fprintf(f, "%s,%s,%d,%ld,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%s,%s,%s\n", backend, config, workers,
+                    cities, b->count, s.min, s.median, s.p90, s.mean, s.stddev, sp, eff, imb);
+        }
+        fclose(f);
+        printf("Benchmark results appended to %s\n", b->out);
+    }
+    return rc;
+}
+
+static inline void bench_free(BenchConfig* b) {
+    free(b->times);
+    b->times = NULL;
+}
+
+#endif
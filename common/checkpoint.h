@@ -0,0 +1,229 @@
+#ifndef WEATHER_CHECKPOINT_H
+#define WEATHER_CHECKPOINT_H
+
+/**
+ * Append-only checkpoint logs of finished per-city aggregates
+ *
+ * Every worker (OpenMP thread, or MPI rank/thread) owns one log file in the
+ * checkpoint directory, so writers never contend. Finished records are
+ * buffered in memory and appended at most once per interval, followed by
+ * fsync; the cost of a checkpoint is therefore bounded by the interval and
+ * a crash loses at most one interval of work per worker. A record is the
+ * raw aggregate struct, which must start with its NUL-terminated name; a
+ * torn record at the end of a log is ignored on load.
+ *
+ * Header-only so the OpenMP and MPI backends can share it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#define CKPT_MAGIC 0x504b4357u   // "WCKP"
+#define CKPT_SUFFIX ".ckpt"
+
+typedef struct {
+    FILE* fp;
+    size_t record_size;
+    double interval;      // seconds between appends
+    double last_flush;
+    char* pending;        // records finished since the last append
+    int npending;
+    int capacity;
+    long records;         // records made durable
+    long bytes;
+    long flushes;
+    double time;          // seconds spent writing and syncing
+} CheckpointLog;
+
+// Records loaded for --resume, sorted by name
+typedef struct {
+    char* records;
+    size_t record_size;
+    int count;
+} CheckpointSet;
+
+static inline double ckpt_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline int ckpt_is_log(const char* filename) {
+    size_t len = strlen(filename), slen = strlen(CKPT_SUFFIX);
+    return len > slen && strcmp(filename + len - slen, CKPT_SUFFIX) == 0;
+}
+
+// Delete every log in dir (a fresh, non-resumed run)
+static inline void ckpt_clear(const char* dir) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+    struct dirent* entry;
+    char path[1024];
+    while ((entry = readdir(d)) != NULL) {
+        if (!ckpt_is_log(entry->d_name)) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        unlink(path);
+    }
+    closedir(d);
+}
+
+// Open (append to) dir/<worker>.ckpt. Returns 0 on success, -1 on failure.
+static inline int ckpt_open(CheckpointLog* log, const char* dir, const char* worker,
+                            size_t record_size, double interval) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s%s", dir, worker, CKPT_SUFFIX);
+    memset(log, 0, sizeof(*log));
+    log->fp = fopen(path, "a+b");
+    if (!log->fp) return -1;
+
+    log->record_size = record_size;
+    log->interval = interval;
+    log->last_flush = ckpt_now();
+
+    // Trim a torn final record (or an incompatible log) before appending
+    unsigned int header[2] = {CKPT_MAGIC, (unsigned int)record_size};
+    unsigned int found[2] = {0, 0};
+    fseek(log->fp, 0, SEEK_END);
+    long size = ftell(log->fp);
+    rewind(log->fp);
+    long keep = 0;
+    if (size >= (long)sizeof(header) && fread(found, sizeof(found), 1, log->fp) == 1 &&
+        found[0] == header[0] && found[1] == header[1]) {
+        keep = sizeof(header) + (size - (long)sizeof(header)) / record_size * record_size;
+    }
+    if (keep != size && ftruncate(fileno(log->fp), keep) != 0) {
+        fclose(log->fp);
+        log->fp = NULL;
+        return -1;
+    }
+    fseek(log->fp, 0, SEEK_END);
+    if (keep == 0) fwrite(header, sizeof(header), 1, log->fp);
+    return 0;
+}
+
+// Append pending records and make them durable
+static inline void ckpt_flush(CheckpointLog* log) {
+    double t0 = ckpt_now();
+    if (log->npending > 0) {
+        fwrite(log->pending, log->record_size, log->npending, log->fp);
+        fflush(log->fp);
+        fsync(fileno(log->fp));
+        log->records += log->npending;
+        log->bytes += (long)log->npending * log->record_size;
+        log->flushes++;
+        log->npending = 0;
+    }
+    log->last_flush = ckpt_now();
+    log->time += log->last_flush - t0;
+}
+
+// Queue one finished record; appends once the interval has elapsed
+static inline void ckpt_add(CheckpointLog* log, const void* record) {
+    if (!log->fp) return;
+    if (log->npending == log->capacity) {
+        int cap = log->capacity ? 2 * log->capacity : 64;
+        char* grown = realloc(log->pending, (size_t)cap * log->record_size);
+        if (!grown) {
+            ckpt_flush(log);
+        } else {
+            log->pending = grown;
+            log->capacity = cap;
+        }
+    }
+    if (log->npending < log->capacity) {
+        memcpy(log->pending + (size_t)log->npending * log->record_size, record, log->record_size);
+        log->npending++;
+    }
+    if (ckpt_now() - log->last_flush >= log->interval) ckpt_flush(log);
+}
+
+static inline void ckpt_close(CheckpointLog* log) {
+    if (!log->fp) return;
+    ckpt_flush(log);
+    fclose(log->fp);
+    free(log->pending);
+    log->fp = NULL;
+    log->pending = NULL;
+}
+
+static inline int ckpt_compare_name(const void* a, const void* b) {
+    return strcmp((const char*)a, (const char*)b);
+}
+
+// Read every log in dir. Logs written with another record size are skipped.
+// Returns the number of records loaded.
+static inline int ckpt_load(const char* dir, size_t record_size, CheckpointSet* set) {
+    set->records = NULL;
+    set->record_size = record_size;
+    set->count = 0;
+
+    DIR* d = opendir(dir);
+    if (!d) return 0;
+    int capacity = 0;
+    struct dirent* entry;
+    char path[1024];
+    while ((entry = readdir(d)) != NULL) {
+        if (!ckpt_is_log(entry->d_name)) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        FILE* fp = fopen(path, "rb");
+        if (!fp) continue;
+
+        unsigned int header[2];
+        if (fread(header, sizeof(header), 1, fp) != 1 || header[0] != CKPT_MAGIC ||
+            header[1] != record_size) {
+            fprintf(stderr, "Skipping incompatible checkpoint %s\n", path);
+            fclose(fp);
+            continue;
+        }
+        for (;;) {
+            if (set->count == capacity) {
+                capacity = capacity ? 2 * capacity : 256;
+                char* grown = realloc(set->records, (size_t)capacity * record_size);
+                if (!grown) break;
+                set->records = grown;
+            }
+            // A short read is a torn final record from a crash: drop it
+            if (fread(set->records + (size_t)set->count * record_size, record_size, 1, fp) != 1) break;
+            set->count++;
+        }
+        fclose(fp);
+    }
+    closedir(d);
+
+    if (set->count > 0) qsort(set->records, set->count, record_size, ckpt_compare_name);
+    return set->count;
+}
+
+static inline const void* ckpt_find(const CheckpointSet* set, const char* name) {
+    if (set->count == 0) return NULL;
+    return bsearch(name, set->records, set->count, set->record_size, ckpt_compare_name);
+}
+
+static inline void ckpt_free_set(CheckpointSet* set) {
+    free(set->records);
+    set->records = NULL;
+    set->count = 0;
+}
+
+// One-line cost summary over a set of logs
+static inline void print_checkpoint_stats(const char* label, const CheckpointLog* logs, int count,
+                                          double elapsed) {
+    long records = 0, bytes = 0, flushes = 0;
+    double time = 0, worst = 0;
+    for (int i = 0; i < count; i++) {
+        records += logs[i].records;
+        bytes += logs[i].bytes;
+        flushes += logs[i].flushes;
+        time += logs[i].time;
+        if (logs[i].time > worst) worst = logs[i].time;
+    }
+    printf("%s checkpoint: %ld records, %.1f KB in %ld appends, %.4f s total (worst worker %.4f s, %.2f%% of run)\n",
+           label, records, bytes / 1024.0, flushes, time, worst,
+           elapsed > 0 ? 100.0 * worst / elapsed : 0);
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef WEATHER_DAYS_H
+#define WEATHER_DAYS_H
+
+/**
+ * Daily-record ranking ("hottest 100 days on Earth")
+ *
+ * A DayRecord is one (city, date, value) row of the dataset. Values are
+ * stored as a key where larger always ranks first (coldest negates the
+ * temperature), so one comparator serves every metric; ties are broken by
+ * city ID and date to keep rankings deterministic across worker counts.
+ *
+ * A DaySink collects one worker's records: with a limit it is a bounded
+ * min-heap holding the best `limit` records seen (root = worst kept), so
+ * selection needs O(limit) memory per worker; with limit 0 it keeps every
+ * record for a full sort.
+ *
+ * Header-only so the OpenMP and MPI backends can share it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    double key;   // ranking key: larger ranks first
+    int city;     // file index of the city
+    int date;     // YYYYMMDD
+} DayRecord;
+
+typedef enum { DAYS_HOTTEST, DAYS_COLDEST, DAYS_WETTEST } DayMetric;
+
+typedef struct {
+    DayRecord* recs;
+    long count;
+    long capacity;
+    long limit;    // > 0: keep the best `limit` records, 0: keep all
+    DayMetric metric;
+    double sign;   // value -> key
+    long seen;     // records offered
+} DaySink;
+
+static inline int parse_day_metric(const char* name, DayMetric* metric) {
+    if (strcmp(name, "hottest") == 0) *metric = DAYS_HOTTEST;
+    else if (strcmp(name, "coldest") == 0) *metric = DAYS_COLDEST;
+    else if (strcmp(name, "wettest") == 0) *metric = DAYS_WETTEST;
+    else return -1;
+    return 0;
+}
+
+static inline const char* day_metric_name(DayMetric metric) {
+    switch (metric) {
+        case DAYS_COLDEST: return "COLDEST";
+        case DAYS_WETTEST: return "WETTEST";
+        default: return "HOTTEST";
+    }
+}
+
+static inline double day_metric_sign(DayMetric metric) {
+    return metric == DAYS_COLDEST ? -1.0 : 1.0;
+}
+
+// Original value of a record's key
+static inline double day_value(const DayRecord* rec, DayMetric metric) {
+    return rec->key * day_metric_sign(metric);
+}
+
+// "YYYY-MM-DD..." -> YYYYMMDD (0 if malformed)
+static inline int day_date(const char* date) {
+    if (strlen(date) < 10 || date[4] != '-' || date[7] != '-') return 0;
+    return atoi(date) * 10000 + atoi(date + 5) * 100 + atoi(date + 8);
+}
+
+// Negative if a ranks before b
+static inline int day_compare(const void* pa, const void* pb) {
+    const DayRecord* a = (const DayRecord*)pa;
+    const DayRecord* b = (const DayRecord*)pb;
+    if (a->key != b->key) return a->key > b->key ? -1 : 1;
+    if (a->city != b->city) return a->city < b->city ? -1 : 1;
+    return (a->date > b->date) - (a->date < b->date);
+}
+
+static inline void day_sink_init(DaySink* sink, long limit, DayMetric metric) {
+    sink->recs = NULL;
+    sink->count = 0;
+    sink->capacity = 0;
+    sink->limit = limit;
+    sink->metric = metric;
+    sink->sign = day_metric_sign(metric);
+    sink->seen = 0;
+}
+
+static inline void day_sink_free(DaySink* sink) {
+    free(sink->recs);
+    sink->recs = NULL;
+    sink->count = sink->capacity = 0;
+}
+
+static inline int day_sink_reserve(DaySink* sink, long n) {
+    if (n <= sink->capacity) return 0;
+    long cap = sink->capacity ? sink->capacity : 1024;
+    while (cap < n) cap *= 2;
+    DayRecord* grown = (DayRecord*)realloc(sink->recs, cap * sizeof(DayRecord));
+    if (!grown) return -1;
+    sink->recs = grown;
+    sink->capacity = cap;
+    return 0;
+}
+
+// Heap order: the worst kept record sits at the root
+static inline void day_heap_sift_down(DayRecord* h, long n, long i) {
+    for (;;) {
+        long worst = i, l = 2 * i + 1, r = l + 1;
+        if (l < n && day_compare(&h[l], &h[worst]) > 0) worst = l;
+        if (r < n && day_compare(&h[r], &h[worst]) > 0) worst = r;
+        if (worst == i) return;
+        DayRecord t = h[i];
+        h[i] = h[worst];
+        h[worst] = t;
+        i = worst;
+    }
+}
+
+static inline int day_sink_push(DaySink* sink, const DayRecord* rec) {
+    sink->seen++;
+    if (sink->limit > 0 && sink->count == sink->limit) {
+        if (day_compare(rec, &sink->recs[0]) >= 0) return 0;
+        sink->recs[0] = *rec;
+        day_heap_sift_down(sink->recs, sink->count, 0);
+        return 0;
+    }
+
+    if (day_sink_reserve(sink, sink->count + 1) != 0) return -1;
+    long i = sink->count++;
+    sink->recs[i] = *rec;
+    if (sink->limit > 0) {
+        while (i > 0) {
+            long parent = (i - 1) / 2;
+            if (day_compare(&sink->recs[i], &sink->recs[parent]) <= 0) break;
+            DayRecord t = sink->recs[i];
+            sink->recs[i] = sink->recs[parent];
+            sink->recs[parent] = t;
+            i = parent;
+        }
+    }
+    return 0;
+}
+
+static inline int day_sink_add(DaySink* sink, double value, int date, int city) {
+    DayRecord rec = {value * sink->sign, city, date};
+    return day_sink_push(sink, &rec);
+}
+
+// Fold another worker's records in (src is left untouched)
+static inline int day_sink_merge(DaySink* dst, const DaySink* src) {
+    long seen = dst->seen + src->seen;
+    for (long i = 0; i < src->count; i++) {
+        if (day_sink_push(dst, &src->recs[i]) != 0) return -1;
+    }
+    dst->seen = seen;
+    return 0;
+}
+
+// Best first; the heap property no longer holds afterwards
+static inline void day_sink_sort(DaySink* sink) {
+    if (sink->count > 1) qsort(sink->recs, sink->count, sizeof(DayRecord), day_compare);
+}
+
+#endif
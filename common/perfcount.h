@@ -0,0 +1,258 @@
+#ifndef WEATHER_PERFCOUNT_H
+#define WEATHER_PERFCOUNT_H
+
+/**
+ * --counters: hardware performance counters per phase and worker
+ *
+ * Each worker thread opens one perf_event_open group (cycles, instructions,
+ * LLC misses, branch misses, dTLB misses) that counts only that thread.
+ * perf_switch() reads the whole group in one read() and charges the
+ * difference since the previous switch to the phase that was running, so
+ * phases are attributed without stopping the counters. Phases are the
+ * caller's indices (phases.h switches them along with its timers). The
+ * report prints IPC and misses per CSV row for every phase, per worker
+ * where more than one worker took part.
+ *
+ * Counting kernel time needs kernel.perf_event_paranoid <= 1; above that
+ * the group falls back to user space only, and without a PMU (most VMs)
+ * or perf support the run continues and the report says why.
+ *
+ * Header-only so every backend can share it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#define PERF_MAX_PHASES 8
+#define PERF_NONE (-1)
+
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_BRANCH_MISSES, PERF_DTLB_MISSES, PERF_NUM_EVENTS };
+
+// Plain data, so ranks can ship it to rank 0 as bytes
+typedef struct {
+    unsigned long long count[PERF_MAX_PHASES][PERF_NUM_EVENTS];
+    long rows;             // CSV rows aggregated by this worker
+    int events;            // bit e set = event e was counted
+    int user_only;         // kernel time excluded
+    int error;             // errno of the failed open, 0 if none
+} PerfTotals;
+
+// One per thread, cache-line aligned so switches never share a line
+typedef struct {
+    PerfTotals t;
+    int fd[PERF_NUM_EVENTS];   // -1 = not open
+    int slot[PERF_NUM_EVENTS]; // position in the group read, -1 = absent
+    int nslots;
+    int phase;                 // phase being charged, PERF_NONE = none
+    double last[PERF_NUM_EVENTS];
+} __attribute__((aligned(64))) PerfCounters;
+
+static inline void perf_init(PerfCounters* pc) {
+    memset(pc, 0, sizeof(*pc));
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) pc->fd[e] = pc->slot[e] = -1;
+    pc->phase = PERF_NONE;
+}
+
+#ifdef __linux__
+static inline int perf_open_event(int e, int exclude_kernel, int group) {
+    static const unsigned int types[PERF_NUM_EVENTS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+    static const unsigned long long configs[PERF_NUM_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[e];
+    attr.config = configs[e];
+    attr.disabled = group == -1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+/**
+ * Open the counter group for the calling thread and start counting
+ *
+ * The first event that opens leads the group; events the CPU lacks are
+ * left out. Returns 0, or -1 with t.error set if nothing could be opened
+ * (counting is then a no-op).
+ */
+static inline int perf_open(PerfCounters* pc) {
+#ifdef __linux__
+    pc->t.error = 0;
+    for (int exclude_kernel = 0; exclude_kernel <= 1; exclude_kernel++) {
+        int group = -1;
+        pc->nslots = 0;
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            int fd = perf_open_event(e, exclude_kernel, group);
+            if (fd < 0) {
+                if (group == -1 && pc->t.error == 0) pc->t.error = errno;
+                continue;
+            }
+            if (group == -1) group = fd;
+            pc->fd[e] = fd;
+            pc->slot[e] = pc->nslots++;
+        }
+        if (group == -1) {
+            // Kernel counting may be all that is forbidden
+            if (pc->t.error == EACCES || pc->t.error == EPERM) {
+                if (!exclude_kernel) pc->t.error = 0;
+                continue;
+            }
+            return -1;
+        }
+
+        pc->t.error = 0;
+        pc->t.user_only = exclude_kernel;
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            if (pc->fd[e] >= 0) pc->t.events |= 1 << e;
+        }
+        ioctl(group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) pc->last[e] = 0;
+        return 0;
+    }
+    return -1;
+#else
+    pc->t.error = ENOSYS;
+    return -1;
+#endif
+}
+
+static inline int perf_leader(const PerfCounters* pc) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (pc->slot[e] == 0) return pc->fd[e];
+    }
+    return -1;
+}
+
+/**
+ * Charge the counts since the last switch to the current phase and make
+ * `phase` current (PERF_NONE stops charging). Values are scaled by
+ * enabled / running time if the kernel had to multiplex the group.
+ */
+static inline void perf_switch(PerfCounters* pc, int phase) {
+#ifdef __linux__
+    int leader = perf_leader(pc);
+    if (leader >= 0) {
+        unsigned long long buf[3 + PERF_NUM_EVENTS];
+        if (read(leader, buf, sizeof(buf)) >= (ssize_t)((3 + pc->nslots) * sizeof(unsigned long long))) {
+            double scale = buf[2] > 0 ? (double)buf[1] / buf[2] : 1.0;
+            for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+                if (pc->slot[e] < 0) continue;
+                double now = buf[3 + pc->slot[e]] * scale;
+                if (pc->phase != PERF_NONE && now > pc->last[e]) {
+                    pc->t.count[pc->phase][e] += (unsigned long long)(now - pc->last[e]);
+                }
+                pc->last[e] = now;
+            }
+        }
+    }
+#endif
+    pc->phase = phase;
+}
+
+// Stop counting; the totals in pc->t are kept and a later perf_open adds to them
+static inline void perf_close(PerfCounters* pc) {
+    perf_switch(pc, PERF_NONE);
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+#ifdef __linux__
+        if (pc->fd[e] >= 0) close(pc->fd[e]);
+#endif
+        pc->fd[e] = pc->slot[e] = -1;
+    }
+    pc->nslots = 0;
+}
+
+static inline const char* perf_error_hint(int error) {
+    if (error == ENOENT || error == EOPNOTSUPP || error == ENODEV) return "no hardware PMU exposed (virtual machine?)";
+    if (error == EACCES || error == EPERM) return "not permitted, lower kernel.perf_event_paranoid";
+    if (error == ENOSYS) return "perf_event_open not supported on this system";
+    return strerror(error);
+}
+
+static inline int perf_any(const unsigned long long* c) {
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (c[e]) return 1;
+    }
+    return 0;
+}
+
+static inline void perf_print_row(const char* phase, const char* worker, const unsigned long long* c,
+                                  int events, long rows) {
+    char v[PERF_NUM_EVENTS][16];
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        if (!(events & (1 << e))) strcpy(v[e], "-");
+        else if (e <= PERF_INSTRUCTIONS) snprintf(v[e], sizeof(v[e]), "%.2f", c[e] / 1e6);
+        else snprintf(v[e], sizeof(v[e]), "%.4f", rows > 0 ? (double)c[e] / rows : 0);
+    }
+    char ipc[16] = "-";
+    if ((events & 3) == 3 && c[PERF_CYCLES] > 0) {
+        snprintf(ipc, sizeof(ipc), "%.2f", (double)c[PERF_INSTRUCTIONS] / c[PERF_CYCLES]);
+    }
+    printf("%-10s %-8s %10s %10s %6s %10s %10s %10s\n", phase, worker, v[PERF_CYCLES], v[PERF_INSTRUCTIONS],
+           ipc, v[PERF_LLC_MISSES], v[PERF_BRANCH_MISSES], v[PERF_DTLB_MISSES]);
+}
+
+/**
+ * Print the counters of n = max(ranks, 1) * threads workers for phases
+ * 0..nphases-1
+ *
+ * ranks is 0 outside MPI. Every phase gets a total row; per-worker rows
+ * follow when more than one worker counted in that phase. Misses are per
+ * CSV row of the whole run, so worker rows add up to the total.
+ */
+static inline void perf_report(const PerfTotals* w, int ranks, int threads, const char* const* names, int nphases) {
+    int n = (ranks > 0 ? ranks : 1) * threads;
+    int events = 0, user_only = 0, error = 0;
+    long rows = 0;
+    for (int i = 0; i < n; i++) {
+        events |= w[i].events;
+        user_only |= w[i].user_only;
+        rows += w[i].rows;
+        if (!error) error = w[i].error;
+    }
+
+    printf("\n========== HARDWARE COUNTERS ==========\n");
+    if (events == 0) {
+        printf("Hardware counters unavailable: %s\n", perf_error_hint(error ? error : ENOSYS));
+        return;
+    }
+    printf("Counted: %s; misses per row over %ld rows\n", user_only ? "user space only" : "user + kernel", rows);
+    printf("%-10s %-8s %10s %10s %6s %10s %10s %10s\n", "Phase", "Worker", "Mcycles", "Minstr", "IPC",
+           "LLC/row", "BrMiss/row", "dTLB/row");
+    printf("--------------------------------------------------------------------------------\n");
+    for (int p = 0; p < nphases; p++) {
+        unsigned long long sum[PERF_NUM_EVENTS] = {0};
+        int active = 0;
+        for (int i = 0; i < n; i++) {
+            for (int e = 0; e < PERF_NUM_EVENTS; e++) sum[e] += w[i].count[p][e];
+            if (perf_any(w[i].count[p])) active++;
+        }
+        if (active == 0) continue;
+        perf_print_row(names[p], "all", sum, events, rows);
+        if (active < 2) continue;
+        for (int i = 0; i < n; i++) {
+            if (!perf_any(w[i].count[p])) continue;
+            char worker[24];
+            if (ranks == 0) snprintf(worker, sizeof(worker), "t%d", i);
+            else if (threads == 1) snprintf(worker, sizeof(worker), "r%d", i);
+            else snprintf(worker, sizeof(worker), "r%d.t%d", i / threads, i % threads);
+            perf_print_row("", worker, w[i].count[p], w[i].events, rows);
+        }
+    }
+}
+
+#endif
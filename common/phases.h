@@ -0,0 +1,113 @@
+#ifndef WEATHER_PHASES_H
+#define WEATHER_PHASES_H
+
+/**
+ * Phase timing shared by every backend
+ *
+ * Each worker thread owns a PhaseTimer and calls phase_switch() when it
+ * moves on; the time since the previous switch is charged to the phase it
+ * leaves. Every backend uses the same phases and the same monotonic clock,
+ * and times the same region as "Processing time" (from the first file to
+ * the reduced result; the directory scan is Enumerate, reported apart),
+ * so their reports compare directly:
+ *
+ *   Enumerate   listing the input directory (MPI: plus the manifest)
+ *   I/O         opening files and reading lines
+ *   Parse       extracting fields from lines
+ *   Aggregate   folding parsed rows into per-city statistics
+ *   Reduce      combining per-thread and per-rank results
+ *   Report      rankings and statistics output
+ *
+ * With --counters the timer also switches its thread's hardware counter
+ * group (perfcount.h), so both break down over the same phases.
+ *
+ * Header-only so every backend can share it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "perfcount.h"
+
+typedef enum {
+    PHASE_NONE = -1,
+    PHASE_ENUMERATE,
+    PHASE_IO,
+    PHASE_PARSE,
+    PHASE_AGGREGATE,
+    PHASE_REDUCE,
+    PHASE_REPORT,
+    NUM_PHASES
+} Phase;
+
+static const char* phase_names[NUM_PHASES] = {"Enumerate", "I/O", "Parse", "Aggregate", "Reduce", "Report"};
+
+// One per thread, cache-line aligned so switches never share a line
+typedef struct {
+    double seconds[NUM_PHASES];
+    double since;              // clock at the last switch
+    int phase;                 // phase being charged, PHASE_NONE = none
+    PerfCounters* perf;        // --counters group of this thread, NULL = time only
+} __attribute__((aligned(64))) PhaseTimer;
+
+static inline double phase_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline void phase_timer_init(PhaseTimer* pt, PerfCounters* perf) {
+    memset(pt, 0, sizeof(*pt));
+    pt->phase = PHASE_NONE;
+    pt->perf = perf;
+}
+
+// Forget the per-run phases (I/O through Reduce) before a --bench rerun;
+// Enumerate happens once and Report after the last run
+static inline void phase_restart(PhaseTimer* pt) {
+    for (int p = PHASE_IO; p <= PHASE_REDUCE; p++) pt->seconds[p] = 0;
+}
+
+// Charge the time since the last switch and make `phase` current
+static inline void phase_switch(PhaseTimer* pt, int phase) {
+    double now = phase_clock();
+    if (pt->phase != PHASE_NONE) pt->seconds[pt->phase] += now - pt->since;
+    pt->since = now;
+    pt->phase = phase;
+    if (pt->perf) perf_switch(pt->perf, phase);
+}
+
+/**
+ * Print min/mean/max per phase over n workers (seconds: n rows of
+ * NUM_PHASES). Only workers that spent time in a phase count for it, so
+ * phases run by the main thread alone are not diluted by idle workers.
+ */
+static inline void phase_report(const double* seconds, int n) {
+    printf("\n========== PHASES ==========\n");
+    printf("%-12s %8s %10s %10s %10s %10s\n", "Phase", "Workers", "Min (s)", "Mean (s)", "Max (s)", "Max/Mean");
+    printf("--------------------------------------------------------------------------------\n");
+    for (int p = 0; p < NUM_PHASES; p++) {
+        int workers = 0;
+        double min = 0, max = 0, sum = 0;
+        for (int w = 0; w < n; w++) {
+            double s = seconds[w * NUM_PHASES + p];
+            if (s <= 0) continue;
+            if (workers == 0 || s < min) min = s;
+            if (s > max) max = s;
+            sum += s;
+            workers++;
+        }
+        double mean = workers > 0 ? sum / workers : 0;
+        printf("%-12s %8d %10.4f %10.4f %10.4f %10.3f\n", phase_names[p], workers, min, mean, max,
+               mean > 0 ? max / mean : 1.0);
+    }
+}
+
+// The timers' phase times as rows for phase_report
+static inline void phase_collect(const PhaseTimer* timers, int n, double* seconds) {
+    for (int w = 0; w < n; w++) {
+        memcpy(&seconds[w * NUM_PHASES], timers[w].seconds, NUM_PHASES * sizeof(double));
+    }
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "weather_api.h"
+
+#define SCRATCH_ARENA_SIZE (4UL * 1024 * 1024)
+
+struct WaContext {
+    char* dir;
+    WaOptions opts;
+    int threads;
+
+    FileList files;
+    CityStats* cities;        // per file, compacted to the readable ones
+    long* file_bytes;         // per file: bytes read, -1 = unreadable
+    int city_capacity;
+
+    Arena* arenas;            // one per thread
+    DaySink* sinks;           // one per thread (opts.days)
+    DaySink days;             // merged, best first
+
+    char error[256];
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int set_error(WaContext* ctx, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(ctx->error, sizeof(ctx->error), fmt, ap);
+    va_end(ap);
+    return -1;
+}
+
+void wa_options_init(WaOptions* opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->max_cities = MAX_CITIES_ALL;
+    opts->days_metric = DAYS_HOTTEST;
+    opts->days_n = 100;
+}
+
+WaContext* wa_open(const char* dir, const WaOptions* opts) {
+    WaContext* ctx = calloc(1, sizeof(WaContext));
+    if (!ctx) return NULL;
+
+    if (opts) ctx->opts = *opts;
+    else wa_options_init(&ctx->opts);
+    if (ctx->opts.max_cities <= 0) ctx->opts.max_cities = MAX_CITIES_ALL;
+    if (ctx->opts.io_size == 0) ctx->opts.io_size = BUFSIZ;
+
+#ifdef _OPENMP
+    ctx->threads = ctx->opts.threads > 0 ? ctx->opts.threads : omp_get_max_threads();
+#else
+    ctx->threads = 1;
+#endif
+
+    file_list_init(&ctx->files);
+    day_sink_init(&ctx->days, ctx->opts.days_n, ctx->opts.days_metric);
+    ctx->dir = strdup(dir);
+    ctx->arenas = calloc(ctx->threads, sizeof(Arena));
+    if (ctx->opts.days) ctx->sinks = calloc(ctx->threads, sizeof(DaySink));
+    if (!ctx->dir || !ctx->arenas || (ctx->opts.days && !ctx->sinks)) {
+        wa_free(ctx);
+        return NULL;
+    }
+
+    // Scratch holds the stdio buffer plus one line
+    size_t scratch = ctx->opts.io_size + MAX_LINE + 2 * ARENA_ALIGN;
+    if (scratch < SCRATCH_ARENA_SIZE) scratch = SCRATCH_ARENA_SIZE;
+    for (int t = 0; t < ctx->threads; t++) {
+        if (arena_init(&ctx->arenas[t], scratch) != 0) {
+            wa_free(ctx);
+            return NULL;
+        }
+        if (ctx->sinks) day_sink_init(&ctx->sinks[t], ctx->opts.days_n, ctx->opts.days_metric);
+    }
+    return ctx;
+}
+
+// Size the per-file tables for the current scan
+static int reserve_cities(WaContext* ctx, int n) {
+    if (n <= ctx->city_capacity) return 0;
+    int cap = ctx->city_capacity ? ctx->city_capacity : 256;
+    while (cap < n) cap *= 2;
+
+    CityStats* cities = realloc(ctx->cities, cap * sizeof(CityStats));
+    if (cities) ctx->cities = cities;
+    long* file_bytes = realloc(ctx->file_bytes, cap * sizeof(long));
+    if (file_bytes) ctx->file_bytes = file_bytes;
+    if (!cities || !file_bytes) return -1;
+
+    ctx->city_capacity = cap;
+    return 0;
+}
+
+int wa_run(WaContext* ctx, WaResults* results) {
+    memset(results, 0, sizeof(*results));
+    ctx->error[0] = '\0';
+    double start = now_sec();
+
+    file_list_clear(&ctx->files);
+    if (file_list_scan(&ctx->files, ctx->dir, ctx->opts.max_cities, 0) != 0) {
+        return set_error(ctx, "cannot list %s", ctx->dir);
+    }
+    int n = ctx->files.count;
+    if (reserve_cities(ctx, n) != 0) {
+        return set_error(ctx, "out of memory for %d cities", n);
+    }
+
+    for (int t = 0; ctx->sinks && t < ctx->threads; t++) {
+        ctx->sinks[t].count = 0;
+        ctx->sinks[t].seen = 0;
+    }
+
+    #pragma omp parallel for schedule(dynamic) num_threads(ctx->threads)
+    for (int f = 0; f < n; f++) {
+        int t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        ctx->file_bytes[f] = process_city_file(file_list_path(&ctx->files, f), &ctx->cities[f],
+                                               &ctx->arenas[t], ctx->opts.io_size,
+                                               ctx->sinks ? &ctx->sinks[t] : NULL, f);
+        strncpy(ctx->cities[f].name, file_list_name(&ctx->files, f), MAX_NAME - 1);
+        ctx->cities[f].name[MAX_NAME - 1] = '\0';
+    }
+
+    // Drop unreadable files; file_bytes becomes the file -> city index map
+    int count = 0;
+    for (int f = 0; f < n; f++) {
+        if (ctx->file_bytes[f] < 0) {
+            results->files_failed++;
+            continue;
+        }
+        results->bytes += ctx->file_bytes[f];
+        if (count != f) ctx->cities[count] = ctx->cities[f];
+        ctx->file_bytes[f] = count++;
+    }
+
+    if (ctx->sinks) {
+        ctx->days.count = 0;
+        ctx->days.seen = 0;
+        for (int t = 0; t < ctx->threads; t++) {
+            if (day_sink_merge(&ctx->days, &ctx->sinks[t]) != 0) {
+                return set_error(ctx, "out of memory merging daily records");
+            }
+        }
+        day_sink_sort(&ctx->days);
+        for (long i = 0; i < ctx->days.count; i++) {
+            ctx->days.recs[i].city = (int)ctx->file_bytes[ctx->days.recs[i].city];
+        }
+        results->days = ctx->days.recs;
+        results->day_count = ctx->days.count;
+    }
+
+    results->cities = ctx->cities;
+    results->city_count = count;
+    compute_totals(ctx->cities, count, &results->totals);
+    results->elapsed = now_sec() - start;
+    return 0;
+}
+
+const char* wa_error(const WaContext* ctx) {
+    return ctx->error;
+}
+
+void wa_free(WaContext* ctx) {
+    if (!ctx) return;
+    for (int t = 0; ctx->arenas && t < ctx->threads; t++) {
+        if (ctx->arenas[t].map) arena_free(&ctx->arenas[t]);
+    }
+    for (int t = 0; ctx->sinks && t < ctx->threads; t++) day_sink_free(&ctx->sinks[t]);
+    day_sink_free(&ctx->days);
+    file_list_free(&ctx->files);
+    free(ctx->arenas);
+    free(ctx->sinks);
+    free(ctx->cities);
+    free(ctx->file_bytes);
+    free(ctx->dir);
+    free(ctx);
+}
@@ -0,0 +1,75 @@
+#ifndef WEATHER_API_H
+#define WEATHER_API_H
+
+/**
+ * Embeddable analysis API (libweather.a)
+ *
+ *   WaOptions opts;
+ *   wa_options_init(&opts);
+ *   opts.threads = 8;
+ *   WaContext* ctx = wa_open("data/cities", &opts);
+ *   WaResults res;
+ *   while (serving) {
+ *       if (wa_run(ctx, &res) != 0) fprintf(stderr, "%s\n", wa_error(ctx));
+ *       ... res.cities[0 .. res.city_count), res.totals ...
+ *   }
+ *   wa_free(ctx);
+ *
+ * All state lives in the context: contexts are independent, so a service
+ * can run several of them from different threads at once. A context is
+ * not itself thread safe. Each wa_run() rescans the directory (new files
+ * are picked up) and reuses the context's file list, city table, scratch
+ * arenas and day heaps, so only the first run pays for allocation; the
+ * OpenMP thread team is kept alive by the runtime between runs. Failures
+ * are reported through wa_error() rather than the exit status.
+ */
+
+#include "weather_core.h"
+
+typedef struct {
+    int max_cities;        // files per run (MAX_CITIES_ALL = every file)
+    int threads;           // OpenMP threads (0 = runtime default)
+    size_t io_size;        // stdio buffer per file (0 = BUFSIZ)
+    int days;              // also rank individual days
+    DayMetric days_metric;
+    long days_n;           // days kept (0 = all)
+} WaOptions;
+
+/**
+ * One run's results, owned by the context and valid until the next
+ * wa_run() or wa_free(). Cities are in directory order; files that could
+ * not be read are left out.
+ */
+typedef struct {
+    const CityStats* cities;
+    int city_count;
+    int files_failed;
+    GlobalTotals totals;
+    const DayRecord* days;     // best first, .city indexes cities (NULL unless opts.days)
+    long day_count;
+    long long bytes;
+    double elapsed;            // seconds, scan through merge
+} WaResults;
+
+typedef struct WaContext WaContext;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void wa_options_init(WaOptions* opts);
+
+// NULL if out of memory or a scratch arena cannot be reserved
+WaContext* wa_open(const char* dir, const WaOptions* opts);
+
+// 0 on success; -1 with wa_error() describing the failure
+int wa_run(WaContext* ctx, WaResults* results);
+
+const char* wa_error(const WaContext* ctx);
+void wa_free(WaContext* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
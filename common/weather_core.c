@@ -0,0 +1,573 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "weather_core.h"
+
+// process_city_file_phased: text buffer holding one batch of lines
+#define PHASE_TEXT (256 * 1024)
+
+int parse_max_cities(const char* arg) {
+    if (strcmp(arg, "all") == 0) return MAX_CITIES_ALL;
+    return atoi(arg);
+}
+
+void file_list_init(FileList* l) {
+    memset(l, 0, sizeof(*l));
+}
+
+void file_list_free(FileList* l) {
+    free(l->paths);
+    free(l->path_off);
+    free(l->name_id);
+    free(l->sizes);
+    free(l->names);
+    free(l->name_off);
+    free(l->name_slots);
+    file_list_init(l);
+}
+
+// Empty the list but keep its buffers for the next scan
+void file_list_clear(FileList* l) {
+    l->count = 0;
+    l->paths_len = 0;
+    l->names_len = 0;
+    l->name_count = 0;
+    for (int i = 0; i < l->name_nslots; i++) l->name_slots[i] = -1;
+}
+
+// Grow *buf (elem bytes each) to hold at least n; 0 on success
+static int grow(void** buf, size_t* cap, size_t n, size_t elem) {
+    if (n <= *cap) return 0;
+    size_t c = *cap ? *cap : 256;
+    while (c < n) c *= 2;
+    void* grown = realloc(*buf, c * elem);
+    if (!grown) return -1;
+    *buf = grown;
+    *cap = c;
+    return 0;
+}
+
+static unsigned int hash_string(const char* s) {
+    unsigned int h = 2166136261u;
+    while (*s) h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+// ID of name in the intern table, adding it if new; -1 on allocation failure
+static int intern_name(FileList* l, const char* name) {
+    if (2 * (l->name_count + 1) > l->name_nslots) {
+        int nslots = l->name_nslots ? 2 * l->name_nslots : 512;
+        int* slots = malloc(nslots * sizeof(int));
+        if (!slots) return -1;
+        for (int i = 0; i < nslots; i++) slots[i] = -1;
+        for (int id = 0; id < l->name_count; id++) {
+            unsigned int h = hash_string(l->names + l->name_off[id]) & (nslots - 1);
+            while (slots[h] != -1) h = (h + 1) & (nslots - 1);
+            slots[h] = id;
+        }
+        free(l->name_slots);
+        l->name_slots = slots;
+        l->name_nslots = nslots;
+    }
+
+    unsigned int h = hash_string(name) & (l->name_nslots - 1);
+    while (l->name_slots[h] != -1) {
+        int id = l->name_slots[h];
+        if (strcmp(l->names + l->name_off[id], name) == 0) return id;
+        h = (h + 1) & (l->name_nslots - 1);
+    }
+
+    size_t len = strlen(name) + 1;
+    size_t name_cap = l->name_capacity;
+    if (grow((void**)&l->names, &l->names_cap, l->names_len + len, 1) != 0 ||
+        grow((void**)&l->name_off, &name_cap, l->name_count + 1, sizeof(size_t)) != 0) {
+        return -1;
+    }
+    l->name_capacity = (int)name_cap;
+    memcpy(l->names + l->names_len, name, len);
+    l->name_off[l->name_count] = l->names_len;
+    l->names_len += len;
+    l->name_slots[h] = l->name_count;
+    return l->name_count++;
+}
+
+// Append dir/filename, deriving its city name. Returns 0, or -1 if out of memory.
+int file_list_add(FileList* l, const char* dir, const char* filename, long long size) {
+    if (l->count == l->capacity) {
+        int cap = l->capacity ? 2 * l->capacity : 256;
+        size_t* path_off = realloc(l->path_off, cap * sizeof(size_t));
+        if (path_off) l->path_off = path_off;
+        int* name_id = realloc(l->name_id, cap * sizeof(int));
+        if (name_id) l->name_id = name_id;
+        long long* sizes = realloc(l->sizes, cap * sizeof(long long));
+        if (sizes) l->sizes = sizes;
+        if (!path_off || !name_id || !sizes) return -1;
+        l->capacity = cap;
+    }
+
+    size_t len = strlen(dir) + 1 + strlen(filename) + 1;
+    if (grow((void**)&l->paths, &l->paths_cap, l->paths_len + len, 1) != 0) return -1;
+    snprintf(l->paths + l->paths_len, len, "%s/%s", dir, filename);
+
+    char name[MAX_NAME];
+    city_name_from_file(filename, name, sizeof(name));
+    int id = intern_name(l, name);
+    if (id < 0) return -1;
+
+    l->path_off[l->count] = l->paths_len;
+    l->paths_len += len;
+    l->name_id[l->count] = id;
+    l->sizes[l->count] = size;
+    l->count++;
+    return 0;
+}
+
+/**
+ * List up to max_files .csv files of dir (directory order)
+ *
+ * with_sizes also records each file's size; fstatat on the open directory
+ * avoids a full path lookup per file. Returns 0, or -1 if the directory
+ * cannot be read or memory runs out.
+ */
+int file_list_scan(FileList* l, const char* dir, int max_files, int with_sizes) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        perror("Failed to open directory");
+        return -1;
+    }
+
+    int rc = 0;
+    struct dirent* entry;
+    while (l->count < max_files && (entry = readdir(d)) != NULL) {
+        char* ext = strrchr(entry->d_name, '.');
+        if (!ext || strcmp(ext, ".csv") != 0) continue;
+
+        long long size = 0;
+        struct stat st;
+        if (with_sizes && fstatat(dirfd(d), entry->d_name, &st, 0) == 0) size = st.st_size;
+
+        if (file_list_add(l, dir, entry->d_name, size) != 0) {
+            fprintf(stderr, "Out of memory listing %s\n", dir);
+            rc = -1;
+            break;
+        }
+    }
+
+    closedir(d);
+    return rc;
+}
+
+// Overwrite entry dst with entry src (compaction; the path bytes stay put)
+void file_list_move(FileList* l, int dst, int src) {
+    l->path_off[dst] = l->path_off[src];
+    l->name_id[dst] = l->name_id[src];
+    l->sizes[dst] = l->sizes[src];
+}
+
+// Parse CSV field - copies to buffer to avoid static buffer issues
+char* get_field(const char* line, int field_num, char* buffer, int buf_size) {
+    int current_field = 0;
+    const char* start = line;
+    const char* end;
+
+    while (current_field < field_num) {
+        start = strchr(start, ',');
+        if (!start) {
+            buffer[0] = '\0';
+            return buffer;
+        }
+        start++;
+        current_field++;
+    }
+
+    end = strchr(start, ',');
+    if (!end) {
+        end = strchr(start, '\n');
+        if (!end) end = start + strlen(start);
+    }
+
+    // Validate length to prevent buffer overflow
+    int len = end - start;
+    if (len < 0 || end < start) {
+        buffer[0] = '\0';
+        return buffer;
+    }
+    if (len >= buf_size) len = buf_size - 1;
+    strncpy(buffer, start, len);
+    buffer[len] = '\0';
+
+    return buffer;
+}
+
+// Extract month from date (YYYY-MM-DD format), 0-indexed, -1 if invalid
+int get_month(const char* date) {
+    if (strlen(date) < 7) return -1;
+    char month_str[3] = {date[5], date[6], '\0'};
+    int month = atoi(month_str) - 1;
+    if (month < 0 || month > 11) return -1;
+    return month;
+}
+
+// "New_York.csv" -> "New York"
+void city_name_from_file(const char* filename, char* name, size_t size) {
+    strncpy(name, filename, size - 1);
+    name[size - 1] = '\0';
+    char* dot = strrchr(name, '.');
+    if (dot) *dot = '\0';
+
+    for (char* p = name; *p; p++) {
+        if (*p == '_') *p = ' ';
+    }
+}
+
+void init_city_stats(CityStats* city) {
+    city->temp_sum = 0;
+    city->temp_min = DBL_MAX;
+    city->temp_max = -DBL_MAX;
+    city->precip_sum = 0;
+    city->temp_count = 0;
+    city->precip_count = 0;
+    city->record_count = 0;
+    memset(city->monthly_temp_sum, 0, sizeof(city->monthly_temp_sum));
+    memset(city->monthly_temp_count, 0, sizeof(city->monthly_temp_count));
+}
+
+// Extract the fields the aggregation uses from one CSV data line; with_date
+// also decodes the date for the daily-record ranking
+void parse_record(const char* line, ParsedRecord* r, int with_date) {
+    char field_buf[64];
+
+    // Get date for month extraction
+    char date[32];
+    get_field(line, FIELD_DATE, date, sizeof(date));
+    r->month = get_month(date);
+    r->date = with_date ? day_date(date) : 0;
+
+    // Get average temperature
+    get_field(line, FIELD_AVG_TEMP, field_buf, sizeof(field_buf));
+    r->has_temp = field_buf[0] != '\0';
+    r->temp = r->has_temp ? atof(field_buf) : 0;
+
+    // Get precipitation
+    get_field(line, FIELD_PRECIP, field_buf, sizeof(field_buf));
+    r->has_precip = field_buf[0] != '\0';
+    r->precip = r->has_precip ? atof(field_buf) : 0;
+}
+
+// Fold one parsed row into a city's statistics; days (may be NULL) also
+// receives the row's value for the daily-record ranking under city_id
+void aggregate_record(CityStats* city, const ParsedRecord* r, DaySink* days, int city_id) {
+    city->record_count++;
+
+    if (r->has_temp) {
+        double temp = r->temp;
+        city->temp_sum += temp;
+        city->temp_count++;
+
+        if (temp < city->temp_min) city->temp_min = temp;
+        if (temp > city->temp_max) city->temp_max = temp;
+
+        if (r->month >= 0) {
+            city->monthly_temp_sum[r->month] += temp;
+            city->monthly_temp_count[r->month]++;
+        }
+        if (days && days->metric != DAYS_WETTEST) day_sink_add(days, temp, r->date, city_id);
+    }
+
+    if (r->has_precip) {
+        city->precip_sum += r->precip;
+        city->precip_count++;
+        if (days && days->metric == DAYS_WETTEST) day_sink_add(days, r->precip, r->date, city_id);
+    }
+}
+
+// Add one CSV data line to a city's statistics (parse + aggregate)
+void accumulate_record(CityStats* city, const char* line, DaySink* days, int city_id) {
+    ParsedRecord r;
+    parse_record(line, &r, days != NULL);
+    aggregate_record(city, &r, days, city_id);
+}
+
+/**
+ * Aggregate one city file into *city (name is left to the caller)
+ *
+ * The stdio buffer (io_size bytes, 0 = BUFSIZ) and line buffer come from
+ * the caller's scratch arena, which is reset first. Returns the bytes
+ * read, or -1 if the file could not be opened or has no header; *city is
+ * initialized either way.
+ */
+long process_city_file(const char* filepath, CityStats* city, Arena* scratch, size_t io_size,
+                       DaySink* days, int city_id) {
+    if (io_size == 0) io_size = BUFSIZ;
+    init_city_stats(city);
+
+    arena_reset(scratch);
+    char* io_buf = (char*)arena_alloc(scratch, io_size);
+    char* line = (char*)arena_alloc(scratch, MAX_LINE);
+    if (!io_buf || !line) {
+        fprintf(stderr, "Scratch arena exhausted\n");
+        return -1;
+    }
+
+    FILE* fp = fopen(filepath, "r");
+    if (!fp) return -1;
+    setvbuf(fp, io_buf, _IOFBF, io_size);
+
+    // Skip header
+    if (!fgets(line, MAX_LINE, fp)) {
+        fclose(fp);
+        return -1;
+    }
+
+    while (fgets(line, MAX_LINE, fp)) {
+        accumulate_record(city, line, days, city_id);
+    }
+
+    long bytes = ftell(fp);
+    fclose(fp);
+    return bytes;
+}
+
+// Parse then aggregate one batch of lines, each pass charged to its phase
+static void run_batch(char** lines, int n, ParsedRecord* recs, CityStats* city, DaySink* days, int city_id,
+                      PhaseTimer* pt) {
+    for (int i = 0; i < n; i++) parse_record(lines[i], &recs[i], days != NULL);
+
+    phase_switch(pt, PHASE_AGGREGATE);
+    for (int i = 0; i < n; i++) aggregate_record(city, &recs[i], days, city_id);
+    if (pt->perf) pt->perf->t.rows += n;
+
+    phase_switch(pt, PHASE_PARSE);
+}
+
+/**
+ * process_city_file with its I/O, parse and aggregate time charged to pt
+ *
+ * The file is read in PHASE_TEXT blocks (I/O); each block is split into
+ * lines and parsed into ParsedRecords in batches of up to PHASE_BATCH
+ * (parse), which are then aggregated (aggregate), so there are three
+ * switches per batch instead of three per row. Lines are split exactly
+ * as fgets(MAX_LINE) would split them, so results are identical to
+ * process_city_file. Opening the file counts as I/O; pt is left in the
+ * parse phase.
+ */
+long process_city_file_phased(const char* filepath, CityStats* city, Arena* scratch, size_t io_size,
+                              DaySink* days, int city_id, PhaseTimer* pt) {
+    if (io_size == 0) io_size = BUFSIZ;
+    init_city_stats(city);
+
+    arena_reset(scratch);
+    char* io_buf = (char*)arena_alloc(scratch, io_size);
+    char* text = (char*)arena_alloc(scratch, PHASE_TEXT + 1);
+    char* piece = (char*)arena_alloc(scratch, MAX_LINE);
+    char** lines = (char**)arena_alloc(scratch, PHASE_BATCH * sizeof(char*));
+    ParsedRecord* recs = (ParsedRecord*)arena_alloc(scratch, PHASE_BATCH * sizeof(ParsedRecord));
+    if (!io_buf || !text || !piece || !lines || !recs) {
+        fprintf(stderr, "Scratch arena exhausted\n");
+        return -1;
+    }
+
+    phase_switch(pt, PHASE_IO);
+    FILE* fp = fopen(filepath, "r");
+    if (!fp) return -1;
+    setvbuf(fp, io_buf, _IOFBF, io_size);
+
+    long bytes = 0;
+    size_t len = 0;        // bytes at the front of text not yet consumed
+    int header = 1;
+    int last = 0;
+    while (!last) {
+        phase_switch(pt, PHASE_IO);
+        size_t got = fread(text + len, 1, PHASE_TEXT - len, fp);
+        bytes += got;
+        len += got;
+        last = len < PHASE_TEXT;   // short read: end of file
+        if (bytes == 0) break;
+
+        phase_switch(pt, PHASE_PARSE);
+        size_t pos = 0;
+        int n = 0;
+        while (pos < len) {
+            // One fgets line: through '\n', MAX_LINE - 1 bytes, or the end of the file
+            char* start = text + pos;
+            size_t avail = len - pos;
+            size_t max = avail < MAX_LINE - 1 ? avail : MAX_LINE - 1;
+            char* nl = (char*)memchr(start, '\n', max);
+            size_t size;
+            if (nl) size = nl - start + 1;
+            else if (max == MAX_LINE - 1 || last) size = max;
+            else break;   // partial line: read more first
+            pos += size;
+
+            if (header) {
+                header = 0;
+                continue;
+            }
+            if (nl) {
+                *nl = '\0';
+                lines[n++] = start;
+            } else if (pos == len && last) {
+                start[size] = '\0';   // final line, text has room for the NUL
+                lines[n++] = start;
+            } else {
+                // Overlong line split like fgets: terminating in place would
+                // clobber the next piece, so it goes through a copy, in order
+                run_batch(lines, n, recs, city, days, city_id, pt);
+                n = 0;
+                memcpy(piece, start, size);
+                piece[size] = '\0';
+                lines[n++] = piece;
+                run_batch(lines, n, recs, city, days, city_id, pt);
+                n = 0;
+            }
+            if (n == PHASE_BATCH) {
+                run_batch(lines, n, recs, city, days, city_id, pt);
+                n = 0;
+            }
+        }
+        run_batch(lines, n, recs, city, days, city_id, pt);
+
+        // Keep the partial line for the next read
+        memmove(text, text + pos, len - pos);
+        len -= pos;
+    }
+
+    fclose(fp);
+    return bytes > 0 ? bytes : -1;
+}
+
+// Combine two partial aggregates of the same city
+void merge_city_stats(CityStats* dst, const CityStats* src) {
+    dst->temp_sum += src->temp_sum;
+    dst->precip_sum += src->precip_sum;
+    dst->temp_count += src->temp_count;
+    dst->precip_count += src->precip_count;
+    dst->record_count += src->record_count;
+    if (src->temp_min < dst->temp_min) dst->temp_min = src->temp_min;
+    if (src->temp_max > dst->temp_max) dst->temp_max = src->temp_max;
+    for (int m = 0; m < 12; m++) {
+        dst->monthly_temp_sum[m] += src->monthly_temp_sum[m];
+        dst->monthly_temp_count[m] += src->monthly_temp_count[m];
+    }
+}
+
+void compute_totals(const CityStats* cities, int city_count, GlobalTotals* t) {
+    t->cities = city_count;
+    t->records = 0;
+    t->temp_count = 0;
+    t->precip_count = 0;
+    t->temp_sum = 0;
+    t->precip_sum = 0;
+    t->temp_min = DBL_MAX;
+    t->temp_max = -DBL_MAX;
+
+    for (int i = 0; i < city_count; i++) {
+        t->records += cities[i].record_count;
+        t->temp_count += cities[i].temp_count;
+        t->precip_count += cities[i].precip_count;
+        t->temp_sum += cities[i].temp_sum;
+        t->precip_sum += cities[i].precip_sum;
+        if (cities[i].temp_count > 0 && cities[i].temp_min < t->temp_min) t->temp_min = cities[i].temp_min;
+        if (cities[i].temp_count > 0 && cities[i].temp_max > t->temp_max) t->temp_max = cities[i].temp_max;
+    }
+}
+
+void merge_totals_into(GlobalTotals* dst, const GlobalTotals* src) {
+    dst->cities += src->cities;
+    dst->records += src->records;
+    dst->temp_count += src->temp_count;
+    dst->precip_count += src->precip_count;
+    dst->temp_sum += src->temp_sum;
+    dst->precip_sum += src->precip_sum;
+    if (src->temp_min < dst->temp_min) dst->temp_min = src->temp_min;
+    if (src->temp_max > dst->temp_max) dst->temp_max = src->temp_max;
+}
+
+void print_overall(const GlobalTotals* t) {
+    printf("\n========== OVERALL STATISTICS ==========\n");
+    printf("Total cities analyzed: %ld\n", t->cities);
+    printf("Total records processed: %ld\n", t->records);
+    printf("Global average temperature: %.2f°C\n",
+           t->temp_count > 0 ? t->temp_sum / t->temp_count : 0);
+}
+
+static double avg_temp_key(const CityStats* c) {
+    return c->temp_count > 0 ? c->temp_sum / c->temp_count : -999;
+}
+
+// Descending by key, ties by name so the order never depends on input order
+static int compare_avg_temp_desc(const void* pa, const void* pb) {
+    const CityStats* a = (const CityStats*)pa;
+    const CityStats* b = (const CityStats*)pb;
+    double ka = avg_temp_key(a), kb = avg_temp_key(b);
+    if (ka != kb) return ka > kb ? -1 : 1;
+    return strcmp(a->name, b->name);
+}
+
+static int compare_precip_desc(const void* pa, const void* pb) {
+    const CityStats* a = (const CityStats*)pa;
+    const CityStats* b = (const CityStats*)pb;
+    if (a->precip_sum != b->precip_sum) return a->precip_sum > b->precip_sum ? -1 : 1;
+    return strcmp(a->name, b->name);
+}
+
+// Top 10 hottest, coldest and wettest; reorders cities (O(n log n))
+void print_rankings(CityStats* cities, int city_count) {
+    printf("\n========== WEATHER ANALYSIS RESULTS ==========\n\n");
+
+    // Sort by average temperature (descending)
+    qsort(cities, city_count, sizeof(CityStats), compare_avg_temp_desc);
+
+    printf("TOP 10 HOTTEST CITIES (by average temperature):\n");
+    printf("%-25s %10s %10s %10s %12s\n", "City", "Avg(°C)", "Min(°C)", "Max(°C)", "Records");
+    printf("--------------------------------------------------------------------------------\n");
+    for (int i = 0; i < 10 && i < city_count; i++) {
+        CityStats* c = &cities[i];
+        if (c->temp_count > 0) {
+            printf("%-25s %10.2f %10.2f %10.2f %12d\n",
+                   c->name,
+                   c->temp_sum / c->temp_count,
+                   c->temp_min,
+                   c->temp_max,
+                   c->record_count);
+        }
+    }
+
+    printf("\nTOP 10 COLDEST CITIES (by average temperature):\n");
+    printf("%-25s %10s %10s %10s %12s\n", "City", "Avg(°C)", "Min(°C)", "Max(°C)", "Records");
+    printf("--------------------------------------------------------------------------------\n");
+    for (int i = city_count - 1; i >= 0 && i >= city_count - 10; i--) {
+        CityStats* c = &cities[i];
+        if (c->temp_count > 0) {
+            printf("%-25s %10.2f %10.2f %10.2f %12d\n",
+                   c->name,
+                   c->temp_sum / c->temp_count,
+                   c->temp_min,
+                   c->temp_max,
+                   c->record_count);
+        }
+    }
+
+    printf("\nTOP 10 WETTEST CITIES (by total precipitation):\n");
+    printf("%-25s %15s %12s\n", "City", "Total(mm)", "Days w/Rain");
+    printf("--------------------------------------------------------------------------------\n");
+
+    // Re-sort by precipitation
+    qsort(cities, city_count, sizeof(CityStats), compare_precip_desc);
+
+    for (int i = 0; i < 10 && i < city_count; i++) {
+        CityStats* c = &cities[i];
+        printf("%-25s %15.2f %12d\n", c->name, c->precip_sum, c->precip_count);
+    }
+}
+
+// Rankings followed by the overall statistics
+void print_results(CityStats* cities, int city_count) {
+    GlobalTotals totals;
+    compute_totals(cities, city_count, &totals);
+    print_rankings(cities, city_count);
+    print_overall(&totals);
+}
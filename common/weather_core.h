@@ -0,0 +1,154 @@
+#ifndef WEATHER_CORE_H
+#define WEATHER_CORE_H
+
+/**
+ * Core analysis library shared by every backend
+ *
+ * Parsing, per-city aggregation, merging and the ranking report live here
+ * once; the serial, OpenMP, MPI and CUDA programs are executors that only
+ * decide which files run where and how partial results are combined.
+ * Built as common/weather_core.o and linked into each binary (the CUDA
+ * build calls it through the extern "C" block below).
+ */
+
+#include <stddef.h>
+#include <limits.h>
+#include "arena.h"
+#include "days.h"
+#include "phases.h"
+
+#define MAX_LINE 1024
+#define MAX_NAME 128
+
+// Lines per parse / aggregate pass of the phase-timed paths
+#define PHASE_BATCH 1024
+
+// max_cities argument value meaning "every file in the directory"
+#define MAX_CITIES_ALL INT_MAX
+
+// Field indices of the CSV schema: station_id(0), city_name(1), date(2),
+// season(3), avg_temp_c(4), min_temp_c(5), max_temp_c(6), precipitation_mm(7)
+#define FIELD_CITY 1
+#define FIELD_DATE 2
+#define FIELD_AVG_TEMP 4
+#define FIELD_PRECIP 7
+
+typedef struct {
+    char name[MAX_NAME];
+    double temp_sum;
+    double temp_min;
+    double temp_max;
+    double precip_sum;
+    int temp_count;
+    int precip_count;
+    int record_count;
+    // Monthly averages (0-11)
+    double monthly_temp_sum[12];
+    int monthly_temp_count[12];
+} CityStats;
+
+// One data row after parsing, before it is folded into a CityStats
+typedef struct {
+    double temp;
+    double precip;
+    int month;             // 0-11, -1 if the date is invalid
+    int date;              // YYYYMMDD, only decoded for day sinks
+    int has_temp;
+    int has_precip;
+} ParsedRecord;
+
+// Mergeable dataset-wide aggregate
+typedef struct {
+    long cities;
+    long records;
+    long temp_count;
+    long precip_count;
+    double temp_sum;
+    double precip_sum;
+    double temp_min;
+    double temp_max;
+} GlobalTotals;
+
+/**
+ * Growable list of input files
+ *
+ * Paths are packed back to back in one buffer and addressed by offset;
+ * city names are interned in a second buffer (one copy per distinct name,
+ * found through an open-addressing table). Memory grows with the number of
+ * files actually listed, so a run over a million station files costs tens
+ * of bytes per file rather than a fixed table. Pointers returned by the
+ * accessors stay valid until the next file_list_add().
+ */
+typedef struct {
+    char* paths;           // NUL-terminated paths, back to back
+    size_t paths_len;
+    size_t paths_cap;
+    size_t* path_off;      // per file: offset into paths
+    int* name_id;          // per file: interned name
+    long long* sizes;      // per file: bytes (0 if not stat'ed)
+    int count;
+    int capacity;
+
+    char* names;           // interned city names, back to back
+    size_t names_len;
+    size_t names_cap;
+    size_t* name_off;      // per name: offset into names
+    int name_count;
+    int name_capacity;
+    int* name_slots;       // name_id, -1 = empty
+    int name_nslots;       // power of two, kept >= 2 * name_count
+} FileList;
+
+static inline const char* file_list_path(const FileList* l, int i) {
+    return l->paths + l->path_off[i];
+}
+
+static inline const char* file_list_name(const FileList* l, int i) {
+    return l->names + l->name_off[l->name_id[i]];
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// max_cities argument: a count, or "all"
+int parse_max_cities(const char* arg);
+
+// File list
+void file_list_init(FileList* l);
+void file_list_free(FileList* l);
+void file_list_clear(FileList* l);
+int file_list_add(FileList* l, const char* dir, const char* filename, long long size);
+int file_list_scan(FileList* l, const char* dir, int max_files, int with_sizes);
+void file_list_move(FileList* l, int dst, int src);
+
+// Parser
+char* get_field(const char* line, int field_num, char* buffer, int buf_size);
+int get_month(const char* date);
+void city_name_from_file(const char* filename, char* name, size_t size);
+
+// Aggregate
+void init_city_stats(CityStats* city);
+void parse_record(const char* line, ParsedRecord* r, int with_date);
+void aggregate_record(CityStats* city, const ParsedRecord* r, DaySink* days, int city_id);
+void accumulate_record(CityStats* city, const char* line, DaySink* days, int city_id);
+long process_city_file(const char* filepath, CityStats* city, Arena* scratch, size_t io_size,
+                       DaySink* days, int city_id);
+long process_city_file_phased(const char* filepath, CityStats* city, Arena* scratch, size_t io_size,
+                              DaySink* days, int city_id, PhaseTimer* pt);
+
+// Merge
+void merge_city_stats(CityStats* dst, const CityStats* src);
+void compute_totals(const CityStats* cities, int city_count, GlobalTotals* t);
+void merge_totals_into(GlobalTotals* dst, const GlobalTotals* src);
+
+// Ranking report
+void print_rankings(CityStats* cities, int city_count);
+void print_overall(const GlobalTotals* t);
+void print_results(CityStats* cities, int city_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
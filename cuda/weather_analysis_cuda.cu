@@ -1,17 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <float.h>
-#include <sys/time.h>
 #include <cuda_runtime.h>
+#include "../common/weather_core.h"
 
-#define MAX_CITIES 2000
-#define MAX_LINE 1024
-#define MAX_NAME 128
 #define MAX_RECORDS_PER_FILE 50000
 #define BLOCK_SIZE 256
 #define WARP_SIZE 32
+#define IO_BUFFER_SIZE BUFSIZ
+#define SCRATCH_ARENA_SIZE (4UL * 1024 * 1024)  // fits one file's parsed batch
 
 // Error checking macro
 #define CUDA_CHECK(call) \
@@ -24,19 +22,6 @@
         } \
     } while(0)
 
-typedef struct {
-    char name[MAX_NAME];
-    double temp_sum;
-    double temp_min;
-    double temp_max;
-    double precip_sum;
-    int temp_count;
-    int precip_count;
-    int record_count;
-    double monthly_temp_sum[12];
-    int monthly_temp_count[12];
-} CityStats;
-
 // Parsed weather record for GPU processing
 typedef struct {
     float avg_temp;
@@ -46,52 +31,9 @@ typedef struct {
     char valid_precip;
 } WeatherRecord;
 
-static CityStats cities[MAX_CITIES];
+static CityStats* cities = NULL;
 static int city_count = 0;
 
-double get_time_sec(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
-}
-
-// Parse CSV field
-char* get_field(char* line, int field_num, char* buffer, int buf_size) {
-    int current_field = 0;
-    char* start = line;
-    char* end;
-
-    while (current_field < field_num) {
-        start = strchr(start, ',');
-        if (!start) {
-            buffer[0] = '\0';
-            return buffer;
-        }
-        start++;
-        current_field++;
-    }
-
-    end = strchr(start, ',');
-    if (!end) {
-        end = strchr(start, '\n');
-        if (!end) end = start + strlen(start);
-    }
-
-    int len = end - start;
-    if (len >= buf_size) len = buf_size - 1;
-    strncpy(buffer, start, len);
-    buffer[len] = '\0';
-
-    return buffer;
-}
-
-// Extract month from date
-int get_month(const char* date) {
-    if (strlen(date) < 7) return -1;
-    char month_str[3] = {date[5], date[6], '\0'};
-    return atoi(month_str) - 1;
-}
-
 // Warp-level reduction for min
 __device__ float warp_reduce_min(float val) {
     for (int offset = WARP_SIZE/2; offset > 0; offset /= 2) {
@@ -235,21 +177,28 @@ __global__ void process_weather_records(
  * 3. Launch CUDA kernel to aggregate statistics in parallel
  * 4. Copy results back to CPU
  */
-void process_city_file_cuda(const char* filepath, const char* city_name) {
+void process_city_file_cuda(const char* filepath, const char* city_name, Arena* scratch) {
+    // Parsed records, stdio buffer and line buffer are per-file scratch:
+    // rewinding the arena replaces a 50,000-record malloc/free per file
+    arena_reset(scratch);
+    WeatherRecord* h_records = (WeatherRecord*)arena_alloc(scratch, MAX_RECORDS_PER_FILE * sizeof(WeatherRecord));
+    char* io_buf = (char*)arena_alloc(scratch, IO_BUFFER_SIZE);
+    char* line = (char*)arena_alloc(scratch, MAX_LINE);
+    if (!h_records || !io_buf || !line) {
+        fprintf(stderr, "Scratch arena exhausted\n");
+        return;
+    }
+    int num_records = 0;
+
     FILE* fp = fopen(filepath, "r");
     if (!fp) return;
+    setvbuf(fp, io_buf, _IOFBF, IO_BUFFER_SIZE);
 
-    // Allocate host memory for parsed records
-    WeatherRecord* h_records = (WeatherRecord*)malloc(MAX_RECORDS_PER_FILE * sizeof(WeatherRecord));
-    int num_records = 0;
-
-    char line[MAX_LINE];
     char field_buf[64];
 
     // Skip header
     if (!fgets(line, MAX_LINE, fp)) {
         fclose(fp);
-        free(h_records);
         return;
     }
 
@@ -261,18 +210,18 @@ void process_city_file_cuda(const char* filepath, const char* city_name) {
 
         // Get date for month
         char date[32];
-        get_field(line, 2, date, sizeof(date));
+        get_field(line, FIELD_DATE, date, sizeof(date));
         rec->month = get_month(date);
 
         // Get average temperature
-        get_field(line, 4, field_buf, sizeof(field_buf));
+        get_field(line, FIELD_AVG_TEMP, field_buf, sizeof(field_buf));
         if (field_buf[0] != '\0') {
             rec->avg_temp = atof(field_buf);
             rec->valid_temp = 1;
         }
 
         // Get precipitation
-        get_field(line, 7, field_buf, sizeof(field_buf));
+        get_field(line, FIELD_PRECIP, field_buf, sizeof(field_buf));
         if (field_buf[0] != '\0') {
             rec->precipitation = atof(field_buf);
             rec->valid_precip = 1;
@@ -283,7 +232,6 @@ void process_city_file_cuda(const char* filepath, const char* city_name) {
     fclose(fp);
 
     if (num_records == 0) {
-        free(h_records);
         return;
     }
 
@@ -362,98 +310,10 @@ void process_city_file_cuda(const char* filepath, const char* city_name) {
     cudaFree(d_precip_count);
     cudaFree(d_monthly_temp_sum);
     cudaFree(d_monthly_temp_count);
-    free(h_records);
 
     city_count++;
 }
 
-void print_results(void) {
-    printf("\n========== WEATHER ANALYSIS RESULTS ==========\n\n");
-
-    // Sort by average temperature (descending)
-    for (int i = 0; i < city_count - 1; i++) {
-        for (int j = i + 1; j < city_count; j++) {
-            double avg_i = cities[i].temp_count > 0 ? cities[i].temp_sum / cities[i].temp_count : -999;
-            double avg_j = cities[j].temp_count > 0 ? cities[j].temp_sum / cities[j].temp_count : -999;
-            if (avg_j > avg_i) {
-                CityStats temp = cities[i];
-                cities[i] = cities[j];
-                cities[j] = temp;
-            }
-        }
-    }
-
-    // Top 10 hottest cities
-    printf("TOP 10 HOTTEST CITIES (by average temperature):\n");
-    printf("%-25s %10s %10s %10s %12s\n", "City", "Avg(°C)", "Min(°C)", "Max(°C)", "Records");
-    printf("--------------------------------------------------------------------------------\n");
-    for (int i = 0; i < 10 && i < city_count; i++) {
-        CityStats* c = &cities[i];
-        if (c->temp_count > 0) {
-            printf("%-25s %10.2f %10.2f %10.2f %12d\n",
-                   c->name,
-                   c->temp_sum / c->temp_count,
-                   c->temp_min,
-                   c->temp_max,
-                   c->record_count);
-        }
-    }
-
-    // Top 10 coldest cities
-    printf("\nTOP 10 COLDEST CITIES (by average temperature):\n");
-    printf("%-25s %10s %10s %10s %12s\n", "City", "Avg(°C)", "Min(°C)", "Max(°C)", "Records");
-    printf("--------------------------------------------------------------------------------\n");
-    for (int i = city_count - 1; i >= city_count - 10 && i >= 0; i--) {
-        CityStats* c = &cities[i];
-        if (c->temp_count > 0) {
-            printf("%-25s %10.2f %10.2f %10.2f %12d\n",
-                   c->name,
-                   c->temp_sum / c->temp_count,
-                   c->temp_min,
-                   c->temp_max,
-                   c->record_count);
-        }
-    }
-
-    // Top 10 wettest cities
-    printf("\nTOP 10 WETTEST CITIES (by total precipitation):\n");
-    printf("%-25s %15s %12s\n", "City", "Total(mm)", "Days w/Rain");
-    printf("--------------------------------------------------------------------------------\n");
-
-    // Re-sort by precipitation
-    for (int i = 0; i < city_count - 1; i++) {
-        for (int j = i + 1; j < city_count; j++) {
-            if (cities[j].precip_sum > cities[i].precip_sum) {
-                CityStats temp = cities[i];
-                cities[i] = cities[j];
-                cities[j] = temp;
-            }
-        }
-    }
-
-    for (int i = 0; i < 10 && i < city_count; i++) {
-        CityStats* c = &cities[i];
-        printf("%-25s %15.2f %12d\n", c->name, c->precip_sum, c->precip_count);
-    }
-
-    // Overall statistics
-    printf("\n========== OVERALL STATISTICS ==========\n");
-    long total_records = 0;
-    double global_temp_sum = 0;
-    int global_temp_count = 0;
-
-    for (int i = 0; i < city_count; i++) {
-        total_records += cities[i].record_count;
-        global_temp_sum += cities[i].temp_sum;
-        global_temp_count += cities[i].temp_count;
-    }
-
-    printf("Total cities analyzed: %d\n", city_count);
-    printf("Total records processed: %ld\n", total_records);
-    printf("Global average temperature: %.2f°C\n",
-           global_temp_count > 0 ? global_temp_sum / global_temp_count : 0);
-}
-
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         printf("Usage: %s <data_directory> [max_cities]\n", argv[0]);
@@ -462,9 +322,9 @@ int main(int argc, char* argv[]) {
     }
 
     const char* data_dir = argv[1];
-    int max_cities = MAX_CITIES;
+    int max_cities = MAX_CITIES_ALL;
     if (argc >= 3) {
-        max_cities = atoi(argv[2]);
+        max_cities = parse_max_cities(argv[2]);
     }
 
     // Check CUDA availability
@@ -480,60 +340,50 @@ int main(int argc, char* argv[]) {
     printf("Weather Analysis - CUDA Version\n");
     printf("CUDA Device: %s (Compute %d.%d)\n", prop.name, prop.major, prop.minor);
     printf("Data directory: %s\n", data_dir);
-    printf("Max cities: %d\n", max_cities);
-
-    double start_time = get_time_sec();
+    if (max_cities == MAX_CITIES_ALL) printf("Max cities: all\n");
+    else printf("Max cities: %d\n", max_cities);
 
-    // Read all CSV files from directory
-    DIR* dir = opendir(data_dir);
-    if (!dir) {
-        perror("Failed to open directory");
+    Arena scratch;
+    if (arena_init(&scratch, SCRATCH_ARENA_SIZE) != 0) {
+        perror("Failed to reserve scratch arena");
         return 1;
     }
 
-    struct dirent* entry;
-    int files_processed = 0;
-
-    while ((entry = readdir(dir)) != NULL && city_count < max_cities) {
-        // Check for .csv extension
-        char* ext = strrchr(entry->d_name, '.');
-        if (!ext || strcmp(ext, ".csv") != 0) continue;
-
-        // Build full path
-        char filepath[512];
-        snprintf(filepath, sizeof(filepath), "%s/%s", data_dir, entry->d_name);
-
-        // Extract city name
-        char city_name[MAX_NAME];
-        strncpy(city_name, entry->d_name, MAX_NAME - 1);
-        city_name[MAX_NAME - 1] = '\0';
-        char* dot = strrchr(city_name, '.');
-        if (dot) *dot = '\0';
+    // List the directory first so Processing time covers the same work
+    // as in the other backends
+    FileList file_list;
+    file_list_init(&file_list);
+    if (file_list_scan(&file_list, data_dir, max_cities, 0) != 0) return 1;
+    printf("Files found: %d\n", file_list.count);
+    cities = (CityStats*)malloc((file_list.count > 0 ? file_list.count : 1) * sizeof(CityStats));
+    if (!cities) {
+        fprintf(stderr, "malloc failed for %d cities\n", file_list.count);
+        return 1;
+    }
 
-        // Replace underscores with spaces
-        for (char* p = city_name; *p; p++) {
-            if (*p == '_') *p = ' ';
-        }
+    double start_time = phase_clock();
 
-        process_city_file_cuda(filepath, city_name);
-        files_processed++;
+    for (int f = 0; f < file_list.count; f++) {
+        process_city_file_cuda(file_list_path(&file_list, f), file_list_name(&file_list, f), &scratch);
 
-        if (files_processed % 100 == 0) {
-            printf("Processed %d cities...\n", files_processed);
+        if ((f + 1) % 100 == 0) {
+            printf("Processed %d cities...\n", f + 1);
         }
     }
 
-    closedir(dir);
-
-    double end_time = get_time_sec();
-    double elapsed = end_time - start_time;
+    double elapsed = phase_clock() - start_time;
 
-    print_results();
+    print_results(cities, city_count);
 
     printf("\n========== PERFORMANCE ==========\n");
     printf("Processing time: %.3f seconds\n", elapsed);
     printf("Cities processed: %d\n", city_count);
     printf("Throughput: %.2f cities/second\n", city_count / elapsed);
+    print_arena_stats("Scratch", &scratch, 1);
+    printf("Peak RSS: %.1f MB\n", peak_rss_kb() / 1024.0);
 
+    arena_free(&scratch);
+    file_list_free(&file_list);
+    free(cities);
     return 0;
 }
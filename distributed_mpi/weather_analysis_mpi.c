@@ -4,435 +4,2139 @@
 #include <dirent.h>
 #include <time.h>
 #include <float.h>
-#include <sys/time.h>
+#include <sys/stat.h>
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "../common/checkpoint.h"
+#include "../common/weather_core.h"
+#include "../common/bench.h"
 
-#define MAX_CITIES 2000
-#define MAX_LINE 1024
-#define MAX_NAME 128
-#define MAX_FILES 2000
+#define IO_BUFFER_SIZE BUFSIZ
+#define SCRATCH_ARENA_SIZE (4UL * 1024 * 1024)
 
-// Field indices for CSV parsing
-#define FIELD_DATE 2
-#define FIELD_AVG_TEMP 4
-#define FIELD_PRECIP 7
+// Streaming nonblocking mode: files per MPI_Isend batch, and the single tag
+// all batches travel on (per-source ordering identifies the batch)
+#define STREAM_BATCH 16
+#define STREAM_TAG 1
 
-typedef struct {
-    char name[MAX_NAME];
-    double temp_sum;
-    double temp_min;
-    double temp_max;
-    double precip_sum;
-    int temp_count;
-    int precip_count;
-    int record_count;
-    // Monthly averages (0-11) - same as serial/OpenMP for consistency
-    double monthly_temp_sum[12];
-    int monthly_temp_count[12];
-} CityStats;
-
-// File list
-static char file_paths[MAX_FILES][512];
-static char city_names[MAX_FILES][MAX_NAME];
-static int num_files = 0;
-
-double get_time_sec(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
-}
-
-char* get_field(char* line, int field_num, char* buffer, int buf_size) {
-    int current_field = 0;
-    char* start = line;
-    char* end;
-
-    while (current_field < field_num) {
-        start = strchr(start, ',');
-        if (!start) {
-            buffer[0] = '\0';
-            return buffer;
-        }
-        start++;
-        current_field++;
-    }
-
-    end = strchr(start, ',');
-    if (!end) {
-        end = strchr(start, '\n');
-        if (!end) end = start + strlen(start);
-    }
-
-    // Fix: validate length to prevent buffer overflow
-    int len = end - start;
-    if (len < 0 || end < start) {
-        buffer[0] = '\0';
-        return buffer;
-    }
-    if (len >= buf_size) len = buf_size - 1;
-    strncpy(buffer, start, len);
-    buffer[len] = '\0';
-
-    return buffer;
-}
-
-// Extract month from date (YYYY-MM-DD format)
-int get_month(const char* date) {
-    if (strlen(date) < 7) return -1;
-    char month_str[3] = {date[5], date[6], '\0'};
-    int month = atoi(month_str) - 1;  // 0-indexed
-    if (month < 0 || month > 11) return -1;
-    return month;
-}
-
-void process_city_file(const char* filepath, CityStats* city) {
-    FILE* fp = fopen(filepath, "r");
-    if (!fp) return;
-
-    city->temp_sum = 0;
-    city->temp_min = DBL_MAX;
-    city->temp_max = -DBL_MAX;
-    city->precip_sum = 0;
-    city->temp_count = 0;
-    city->precip_count = 0;
-    city->record_count = 0;
-    memset(city->monthly_temp_sum, 0, sizeof(city->monthly_temp_sum));
-    memset(city->monthly_temp_count, 0, sizeof(city->monthly_temp_count));
-
-    char line[MAX_LINE];
-    char field_buf[64];
-
-    // Skip header
-    if (!fgets(line, MAX_LINE, fp)) {
-        fclose(fp);
-        return;
-    }
-
-    while (fgets(line, MAX_LINE, fp)) {
-        city->record_count++;
-
-        // Get date for month extraction
-        char date[32];
-        get_field(line, FIELD_DATE, date, sizeof(date));
-        int month = get_month(date);
-
-        // Get average temperature
-        get_field(line, FIELD_AVG_TEMP, field_buf, sizeof(field_buf));
-        if (field_buf[0] != '\0') {
-            double temp = atof(field_buf);
-            city->temp_sum += temp;
-            city->temp_count++;
-
-            if (temp < city->temp_min) city->temp_min = temp;
-            if (temp > city->temp_max) city->temp_max = temp;
-
-            // Monthly tracking (same as serial/OpenMP)
-            if (month >= 0 && month < 12) {
-                city->monthly_temp_sum[month] += temp;
-                city->monthly_temp_count[month]++;
+// MPI-IO mode: bytes read per collective call, and per probe for the line
+// break that starts a rank's range
+#define MPIIO_BLOCK (32 * 1024 * 1024)
+#define MPIIO_PROBE 4096
+
+// Checkpoint appends per thread at most every this many seconds by default
+#define CKPT_DEFAULT_INTERVAL 30.0
+
+// Daily-record ranking: records listed by default, and samples each rank
+// contributes to splitter selection in the --days-sort sample sort
+#define DAYS_DEFAULT_N 100
+#define DAYS_SAMPLES 64
+
+// Dynamic mode: each grab takes remaining / (DYN_BATCH_DIVISOR * ranks) files
+#define DYN_BATCH_DIVISOR 2
+
+// Candidates per ranking each rank sends in "reduce" mode
+#define TOP_K 10
+
+// Packed wire format: worst case per city is 16 varints (5 bytes each,
+// city ID, 3 counts, 12 monthly counts) plus 16 doubles
+#define PACKED_CITY_MAX (16 * 5 + 16 * 8)
+
+typedef enum { WIRE_STRUCT, WIRE_PACKED, WIRE_PACKED_F32 } WireFormat;
+
+// File list (the city ID of a file is its index in this list)
+static FileList file_list;
+
+// One checkpoint log per thread of this rank (NULL = checkpointing disabled)
+static CheckpointLog* ckpt_logs = NULL;
+
+// One day sink per thread of this rank for --days (NULL = query disabled)
+static DaySink* day_sinks = NULL;
+
+// One counter group per thread of this rank for --counters (NULL =
+// disabled); thread 0 is the main thread and stays open for the whole run
+static PerfCounters* perf_counters = NULL;
+
+// One phase timer per thread of this rank; thread 0 is the main thread,
+// which also times enumerate, reduce and report
+static PhaseTimer* phase_timers = NULL;
+
+// CPU seconds used by all threads of this process
+static double cpu_time_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// --resume (rank 0, before the manifest broadcast): drop files already in
+// the checkpoint from the file list and return their results in *restored
+static int resume_from_checkpoint(const char* dir, CityStats** restored) {
+    CheckpointSet set;
+    ckpt_load(dir, sizeof(CityStats), &set);
+    *restored = malloc((set.count > 0 ? set.count : 1) * sizeof(CityStats));
+    if (!*restored) {
+        fprintf(stderr, "Rank 0: malloc failed for restored results\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    int count = 0, kept = 0;
+    for (int f = 0; f < file_list.count; f++) {
+        const CityStats* done = ckpt_find(&set, file_list_name(&file_list, f));
+        if (done) {
+            (*restored)[count++] = *done;
+            continue;
+        }
+        if (kept != f) file_list_move(&file_list, kept, f);
+        kept++;
+    }
+    file_list.count = kept;
+
+    ckpt_free_set(&set);
+    return count;
+}
+
+/**
+ * Broadcast rank 0's file list as a compact manifest
+ *
+ * Layout: int64 size[count], then the file names (not full paths) as
+ * consecutive NUL-terminated strings. A file's city ID is its position.
+ * Other ranks rebuild the file list locally from data_dir, so the
+ * directory is listed once instead of once per rank.
+ * Returns the manifest size in bytes.
+ */
+static long broadcast_manifest(const char* data_dir, int rank) {
+    long header[2] = {0, 0};  // file count, manifest bytes
+    char* manifest = NULL;
+
+    if (rank == 0) {
+        long names_len = 0;
+        for (int i = 0; i < file_list.count; i++) {
+            names_len += strlen(strrchr(file_list_path(&file_list, i), '/') + 1) + 1;
+        }
+        header[0] = file_list.count;
+        header[1] = file_list.count * (long)sizeof(long long) + names_len;
+
+        manifest = malloc(header[1] > 0 ? header[1] : 1);
+        if (!manifest) {
+            fprintf(stderr, "Rank 0: malloc failed for manifest\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        memcpy(manifest, file_list.sizes, file_list.count * sizeof(long long));
+        char* p = manifest + file_list.count * sizeof(long long);
+        for (int i = 0; i < file_list.count; i++) {
+            const char* filename = strrchr(file_list_path(&file_list, i), '/') + 1;
+            size_t len = strlen(filename) + 1;
+            memcpy(p, filename, len);
+            p += len;
+        }
+    }
+
+    MPI_Bcast(header, 2, MPI_LONG, 0, MPI_COMM_WORLD);
+    if (header[1] == 0) return 0;
+
+    if (rank != 0) {
+        manifest = malloc(header[1]);
+        if (!manifest) {
+            fprintf(stderr, "Rank %d: malloc failed for manifest\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    MPI_Bcast(manifest, (int)header[1], MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    if (rank != 0) {
+        const long long* sizes = (const long long*)manifest;
+        const char* filename = manifest + header[0] * sizeof(long long);
+        for (int i = 0; i < header[0]; i++) {
+            if (file_list_add(&file_list, data_dir, filename, sizes[i]) != 0) {
+                fprintf(stderr, "Rank %d: malloc failed for file list\n", rank);
+                MPI_Abort(MPI_COMM_WORLD, 1);
             }
+            filename += strlen(filename) + 1;
         }
+    }
 
-        // Get precipitation
-        get_field(line, FIELD_PRECIP, field_buf, sizeof(field_buf));
-        if (field_buf[0] != '\0') {
-            double precip = atof(field_buf);
-            city->precip_sum += precip;
-            city->precip_count++;
+    free(manifest);
+    return header[1];
+}
+
+// MPI datatype for CityStats (includes monthly arrays)
+static MPI_Datatype create_city_type(void) {
+    MPI_Datatype city_type;
+    int blocklengths[] = {MAX_NAME, 1, 1, 1, 1, 1, 1, 1, 12, 12};
+    MPI_Aint offsets[10];
+    offsets[0] = offsetof(CityStats, name);
+    offsets[1] = offsetof(CityStats, temp_sum);
+    offsets[2] = offsetof(CityStats, temp_min);
+    offsets[3] = offsetof(CityStats, temp_max);
+    offsets[4] = offsetof(CityStats, precip_sum);
+    offsets[5] = offsetof(CityStats, temp_count);
+    offsets[6] = offsetof(CityStats, precip_count);
+    offsets[7] = offsetof(CityStats, record_count);
+    offsets[8] = offsetof(CityStats, monthly_temp_sum);
+    offsets[9] = offsetof(CityStats, monthly_temp_count);
+    MPI_Datatype types[] = {MPI_CHAR, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE,
+                            MPI_INT, MPI_INT, MPI_INT, MPI_DOUBLE, MPI_INT};
+
+    MPI_Type_create_struct(10, blocklengths, offsets, types, &city_type);
+    MPI_Type_commit(&city_type);
+    return city_type;
+}
+
+// Largest file first; ties broken by index so every rank sorts identically
+static int compare_size_desc(const void* a, const void* b) {
+    int ia = *(const int*)a, ib = *(const int*)b;
+    if (file_list.sizes[ia] != file_list.sizes[ib]) return file_list.sizes[ia] < file_list.sizes[ib] ? 1 : -1;
+    return ia - ib;
+}
+
+/**
+ * Byte-balanced static partitioning (greedy LPT bin packing)
+ *
+ * Files are taken largest first and each goes to the rank with the fewest
+ * bytes so far. Every rank runs the same deterministic assignment on the
+ * broadcast manifest and keeps its own files, largest first.
+ */
+static int assign_balanced(int rank, int size, int* my_file_indices, Arena* arena) {
+    size_t mark = arena_mark(arena);
+    int* order = arena_alloc(arena, file_list.count * sizeof(int));
+    long long* load = arena_alloc(arena, size * sizeof(long long));
+    if (!order || !load) {
+        fprintf(stderr, "Rank %d: arena exhausted for balanced partitioning\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    for (int i = 0; i < file_list.count; i++) order[i] = i;
+    qsort(order, file_list.count, sizeof(int), compare_size_desc);
+    memset(load, 0, size * sizeof(long long));
+
+    int my_count = 0;
+    for (int i = 0; i < file_list.count; i++) {
+        int target = 0;
+        for (int r = 1; r < size; r++) {
+            if (load[r] < load[target]) target = r;
         }
+        load[target] += file_list.sizes[order[i]];
+        if (target == rank) my_file_indices[my_count++] = order[i];
     }
 
-    fclose(fp);
+    arena_reset_to(arena, mark);
+    return my_count;
 }
 
-void collect_files(const char* data_dir, int max_cities) {
-    DIR* dir = opendir(data_dir);
-    if (!dir) {
-        perror("Failed to open directory");
-        return;
+// Process files[0..count) into results[0..count). Hybrid build: threads
+// share the files and write disjoint slots of results; the record count is
+// reduced across threads before the (master-thread only) MPI calls.
+static long process_file_list(const int* files, int count, CityStats* results, Arena* worker_arenas) {
+    long records = 0;
+#ifdef _OPENMP
+    #pragma omp parallel reduction(+:records)
+#endif
+    {
+#ifdef _OPENMP
+        int tid = omp_get_thread_num();
+#else
+        int tid = 0;
+#endif
+        PerfCounters* pc = perf_counters ? &perf_counters[tid] : NULL;
+        if (pc && tid > 0) perf_open(pc);
+        PhaseTimer* pt = &phase_timers[tid];
+
+        // nowait: a thread's timer and counters stop before it waits for the others
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic) nowait
+#endif
+        for (int i = 0; i < count; i++) {
+            int file_idx = files[i];
+            strncpy(results[i].name, file_list_name(&file_list, file_idx), MAX_NAME - 1);
+            results[i].name[MAX_NAME - 1] = '\0';
+            const char* path = file_list_path(&file_list, file_idx);
+            DaySink* days = day_sinks ? &day_sinks[tid] : NULL;
+            process_city_file_phased(path, &results[i], &worker_arenas[tid], IO_BUFFER_SIZE, days, file_idx, pt);
+            if (ckpt_logs) {
+                phase_switch(pt, PHASE_IO);
+                ckpt_add(&ckpt_logs[tid], &results[i]);
+            }
+            records += results[i].record_count;
+        }
+
+        phase_switch(pt, PHASE_NONE);
+        if (pc && tid > 0) perf_close(pc);
+    }
+    return records;
+}
+
+/**
+ * Dynamic self-scheduling through a shared work counter
+ *
+ * Rank 0 exposes one int in an RMA window; every rank (rank 0 included,
+ * there is no dedicated master) claims the next batch of files with
+ * MPI_Fetch_and_op(MPI_SUM) under a shared passive-target lock. Batches
+ * shrink as work runs out, guided-style: remaining / (DYN_BATCH_DIVISOR *
+ * ranks), using the last counter value this rank saw, but never fewer than
+ * min_batch files (the thread count, so hybrid ranks keep every thread busy).
+ * Claimed file indices go to my_file_indices. Returns the number of files
+ * this rank processed.
+ */
+static int process_dynamic(int size, int min_batch, int* my_file_indices, CityStats* results,
+                           Arena* worker_arenas, long* records, int* fetches) {
+    int* counter;
+    MPI_Win win;
+    MPI_Aint win_size = 0;
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) win_size = sizeof(int);
+
+    MPI_Win_allocate(win_size, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &counter, &win);
+    if (rank == 0) {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+        *counter = 0;
+        MPI_Win_unlock(0, win);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    int my_count = 0;
+    int seen = 0;
+    *records = 0;
+    *fetches = 0;
+
+    MPI_Win_lock_all(0, win);
+    while (1) {
+        int batch = (file_list.count - seen) / (DYN_BATCH_DIVISOR * size);
+        if (batch < min_batch) batch = min_batch;
+
+        int start;
+        MPI_Fetch_and_op(&batch, &start, MPI_INT, 0, 0, MPI_SUM, win);
+        MPI_Win_flush(0, win);
+        (*fetches)++;
+        if (start >= file_list.count) break;
+
+        int end = start + batch;
+        if (end > file_list.count) end = file_list.count;
+        for (int f = start; f < end; f++) {
+            my_file_indices[my_count + f - start] = f;
+        }
+
+        *records += process_file_list(&my_file_indices[my_count], end - start,
+                                      &results[my_count], worker_arenas);
+        my_count += end - start;
+        seen = end;
     }
+    MPI_Win_unlock_all(win);
 
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL && num_files < max_cities) {
-        char* ext = strrchr(entry->d_name, '.');
-        if (!ext || strcmp(ext, ".csv") != 0) continue;
+    MPI_Win_free(&win);
+    return my_count;
+}
 
-        snprintf(file_paths[num_files], sizeof(file_paths[0]), "%s/%s", data_dir, entry->d_name);
+// Per-rank file and byte totals plus the resulting byte imbalance (rank 0 prints)
+static void print_distribution(int my_count, long long my_bytes, double my_process, int rank, int size) {
+    int* counts = NULL;
+    long long* bytes = NULL;
+    double* times = NULL;
+    if (rank == 0) {
+        counts = malloc(size * sizeof(int));
+        bytes = malloc(size * sizeof(long long));
+        times = malloc(size * sizeof(double));
+        if (!counts || !bytes || !times) {
+            fprintf(stderr, "Rank 0: malloc failed for distribution report\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
 
-        strncpy(city_names[num_files], entry->d_name, MAX_NAME - 1);
-        city_names[num_files][MAX_NAME - 1] = '\0';
-        char* dot = strrchr(city_names[num_files], '.');
-        if (dot) *dot = '\0';
+    MPI_Gather(&my_count, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Gather(&my_bytes, 1, MPI_LONG_LONG, bytes, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    MPI_Gather(&my_process, 1, MPI_DOUBLE, times, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
-        for (char* p = city_names[num_files]; *p; p++) {
-            if (*p == '_') *p = ' ';
+    if (rank == 0) {
+        long long total = 0, max_bytes = 0;
+        printf("\n========== DISTRIBUTION ==========\n");
+        printf("%-8s %8s %14s %12s %10s\n", "Rank", "Files", "MB", "Process (s)", "MB/s");
+        printf("--------------------------------------------------------------------------------\n");
+        for (int r = 0; r < size; r++) {
+            printf("%-8d %8d %14.2f %12.3f %10.1f\n", r, counts[r], bytes[r] / 1e6, times[r],
+                   times[r] > 0 ? bytes[r] / 1e6 / times[r] : 0);
+            total += bytes[r];
+            if (bytes[r] > max_bytes) max_bytes = bytes[r];
         }
+        double mean = (double)total / size;
+        printf("Byte imbalance (max/mean): %.3f\n", mean > 0 ? max_bytes / mean : 1.0);
 
-        num_files++;
+        free(counts);
+        free(bytes);
+        free(times);
     }
+}
+
+// Every worker's phase times to rank 0, which prints the PHASES table
+static void print_phase_table(const PhaseTimer* timers, int threads, int rank, int size) {
+    double* mine = malloc(threads * NUM_PHASES * sizeof(double));
+    double* all = rank == 0 ? malloc((size_t)size * threads * NUM_PHASES * sizeof(double)) : NULL;
+    if (!mine || (rank == 0 && !all)) {
+        fprintf(stderr, "Rank %d: malloc failed for phase report\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    phase_collect(timers, threads, mine);
+    MPI_Gather(mine, threads * NUM_PHASES, MPI_DOUBLE, all, threads * NUM_PHASES, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (rank == 0) phase_report(all, size * threads);
+
+    free(mine);
+    free(all);
+}
+
+/**
+ * Print the PHASES table for every rank and thread and name the bottleneck
+ *
+ * The reduce phase of a fast rank includes waiting for the slowest one,
+ * so the minimum reduce time is used as the cost of communication itself
+ * and (max - min) as straggler wait. Processing CPU utilisation (process
+ * CPU time / (wall * threads)) separates blocking I/O from parsing.
+ */
+static void print_phase_report(const PhaseTimer* timers, double process_time, double process_cpu, int threads,
+                               int rank, int size) {
+    print_phase_table(timers, threads, rank, size);
+
+    // Per rank: the main thread's enumerate, reduce and report around the processing time
+    enum { RANK_ENUMERATE, RANK_PROCESS, RANK_REDUCE, RANK_REPORT, RANK_UTIL, RANK_VALUES };
+    double mine[RANK_VALUES], mins[RANK_VALUES], sums[RANK_VALUES], maxs[RANK_VALUES];
+    mine[RANK_ENUMERATE] = timers[0].seconds[PHASE_ENUMERATE];
+    mine[RANK_PROCESS] = process_time;
+    mine[RANK_REDUCE] = timers[0].seconds[PHASE_REDUCE];
+    mine[RANK_REPORT] = timers[0].seconds[PHASE_REPORT];
+    mine[RANK_UTIL] = process_time > 0 ? process_cpu / (process_time * threads) : 1.0;
+
+    MPI_Reduce(mine, mins, RANK_VALUES, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(mine, sums, RANK_VALUES, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(mine, maxs, RANK_VALUES, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank != 0) return;
+
+    double util = sums[RANK_UTIL] / size;
+    printf("Processing CPU utilisation: min %.0f%%, mean %.0f%%, max %.0f%%\n",
+           100 * mins[RANK_UTIL], 100 * util, 100 * maxs[RANK_UTIL]);
+
+    double wall = 0;
+    for (int v = RANK_ENUMERATE; v <= RANK_REPORT; v++) wall += maxs[v];
+    double comm = mins[RANK_REDUCE];
+    double proc_mean = sums[RANK_PROCESS] / size;
+    double imbalance = proc_mean > 0 ? maxs[RANK_PROCESS] / proc_mean : 1.0;
+    printf("Communication (min reduce): %.4f s; straggler wait (max - min reduce): %.4f s\n",
+           comm, maxs[RANK_REDUCE] - mins[RANK_REDUCE]);
+
+    if (wall <= 0) return;
+    printf("Bottleneck: ");
+    if (maxs[RANK_ENUMERATE] > 0.5 * wall) {
+        printf("enumeration (directory listing / metadata I/O is %.0f%% of the run)\n",
+               100 * maxs[RANK_ENUMERATE] / wall);
+    } else if (comm > 0.25 * wall) {
+        printf("communication-bound (%.0f%% of the run in result collection)\n", 100 * comm / wall);
+    } else if (imbalance > 1.2) {
+        printf("compute-imbalanced (slowest rank processes %.2fx the mean)\n", imbalance);
+    } else if (util < 0.7) {
+        printf("I/O-bound (workers busy only %.0f%% of processing time)\n", 100 * util);
+    } else {
+        printf("compute-bound, balanced (imbalance %.2f, CPU utilisation %.0f%%)\n", imbalance, 100 * util);
+    }
+}
+
+// --counters: every rank's per-thread totals to rank 0, which prints them
+static void print_counters(const PerfCounters* perf, int threads, int rank, int size) {
+    PerfTotals* mine = malloc(threads * sizeof(PerfTotals));
+    PerfTotals* all = rank == 0 ? malloc((size_t)size * threads * sizeof(PerfTotals)) : NULL;
+    if (!mine || (rank == 0 && !all)) {
+        fprintf(stderr, "Rank %d: malloc failed for counter report\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int t = 0; t < threads; t++) mine[t] = perf[t].t;
+
+    int bytes = threads * (int)sizeof(PerfTotals);
+    MPI_Gather(mine, bytes, MPI_BYTE, all, bytes, MPI_BYTE, 0, MPI_COMM_WORLD);
+    if (rank == 0) perf_report(all, size, threads, phase_names, NUM_PHASES);
+
+    free(mine);
+    free(all);
+}
+
+// MPI_Op callback: inout[i] = merge(in[i], inout[i])
+static void merge_totals(void* in, void* inout, int* len, MPI_Datatype* type) {
+    (void)type;
+    GlobalTotals* a = in;
+    GlobalTotals* b = inout;
+    for (int i = 0; i < *len; i++) merge_totals_into(&b[i], &a[i]);
+}
+
+// Ranking keys, matching the sort order used by print_rankings
+static double key_hottest(const CityStats* c) {
+    return c->temp_count > 0 ? c->temp_sum / c->temp_count : -999;
+}
+
+static double key_coldest(const CityStats* c) {
+    return -key_hottest(c);
+}
 
-    closedir(dir);
+static double key_wettest(const CityStats* c) {
+    return c->precip_sum;
 }
 
-void print_results(CityStats* cities, int city_count) {
-    printf("\n========== WEATHER ANALYSIS RESULTS ==========\n\n");
+// Mark the k cities with the largest key in picked[] (O(n*k) selection)
+static void select_top_k(const CityStats* cities, int n, int k, double (*key)(const CityStats*), char* picked) {
+    int best[TOP_K];
+    int nbest = 0;
+    if (k > TOP_K) k = TOP_K;
 
-    // Sort by average temperature (descending)
-    for (int i = 0; i < city_count - 1; i++) {
-        for (int j = i + 1; j < city_count; j++) {
-            double avg_i = cities[i].temp_count > 0 ? cities[i].temp_sum / cities[i].temp_count : -999;
-            double avg_j = cities[j].temp_count > 0 ? cities[j].temp_sum / cities[j].temp_count : -999;
-            if (avg_j > avg_i) {
-                CityStats temp = cities[i];
-                cities[i] = cities[j];
-                cities[j] = temp;
+    for (int i = 0; i < n; i++) {
+        double v = key(&cities[i]);
+        if (nbest == k && v <= key(&cities[best[nbest - 1]])) continue;
+
+        int pos = nbest < k ? nbest++ : k - 1;
+        while (pos > 0 && key(&cities[best[pos - 1]]) < v) {
+            best[pos] = best[pos - 1];
+            pos--;
+        }
+        best[pos] = i;
+    }
+
+    for (int i = 0; i < nbest; i++) picked[best[i]] = 1;
+}
+
+// Combine GlobalTotals onto rank 0 of comm with the merge_totals MPI_Op
+static void reduce_totals(GlobalTotals* mine, GlobalTotals* totals, MPI_Comm comm) {
+    MPI_Datatype totals_type;
+    int blocklengths[] = {4, 4};
+    MPI_Aint offsets[] = {offsetof(GlobalTotals, cities), offsetof(GlobalTotals, temp_sum)};
+    MPI_Datatype types[] = {MPI_LONG, MPI_DOUBLE};
+    MPI_Type_create_struct(2, blocklengths, offsets, types, &totals_type);
+    MPI_Type_commit(&totals_type);
+
+    MPI_Op merge_op;
+    MPI_Op_create(merge_totals, 1, &merge_op);
+    MPI_Reduce(mine, totals, 1, totals_type, merge_op, 0, comm);
+    MPI_Op_free(&merge_op);
+    MPI_Type_free(&totals_type);
+}
+
+/**
+ * Reduction-based result collection ("reduce" comm_mode)
+ *
+ * Global totals are combined with MPI_Reduce and a user-defined MPI_Op over
+ * GlobalTotals. For the rankings each rank only sends the union of its
+ * local top-k hottest, coldest and wettest cities (at most 3 * TOP_K);
+ * since every city lives on exactly one rank, the global top-k of each
+ * ranking is contained in the union of these candidates. Rank 0 memory and
+ * gather volume are O(ranks * TOP_K), independent of the station count.
+ * Returns the number of candidates gathered in *candidates (rank 0).
+ */
+static int reduce_results(CityStats* local, int count, MPI_Datatype city_type, int rank, int size,
+                          Arena* arena, CityStats** candidates, GlobalTotals* totals) {
+    GlobalTotals mine;
+    compute_totals(local, count, &mine);
+
+    reduce_totals(&mine, totals, MPI_COMM_WORLD);
+
+    // Local candidates: union of the three local top-k sets
+    char* picked = arena_alloc(arena, count > 0 ? count : 1);
+    CityStats* mine_cand = arena_alloc(arena, 3 * TOP_K * sizeof(CityStats));
+    if (!picked || !mine_cand) {
+        fprintf(stderr, "Rank %d: arena exhausted for candidates\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    memset(picked, 0, count);
+    select_top_k(local, count, TOP_K, key_hottest, picked);
+    select_top_k(local, count, TOP_K, key_coldest, picked);
+    select_top_k(local, count, TOP_K, key_wettest, picked);
+
+    int ncand = 0;
+    for (int i = 0; i < count; i++) {
+        if (picked[i]) mine_cand[ncand++] = local[i];
+    }
+
+    int* counts = NULL;
+    int* displs = NULL;
+    int total = 0;
+    if (rank == 0) {
+        counts = arena_alloc(arena, size * sizeof(int));
+        displs = arena_alloc(arena, size * sizeof(int));
+        *candidates = arena_alloc(arena, (size_t)size * 3 * TOP_K * sizeof(CityStats));
+        if (!counts || !displs || !*candidates) {
+            fprintf(stderr, "Rank 0: arena exhausted for candidate gather\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    MPI_Gather(&ncand, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) {
+            displs[r] = total;
+            total += counts[r];
+        }
+    }
+    MPI_Gatherv(mine_cand, ncand, city_type, rank == 0 ? *candidates : NULL, counts, displs,
+                city_type, 0, MPI_COMM_WORLD);
+
+    return total;
+}
+
+/**
+ * Node-aware two-level collection ("hierarchical" comm_mode)
+ *
+ * Ranks on one node (MPI_Comm_split_type SHARED) copy their cities into
+ * their segment of an MPI_Win_allocate_shared window. Segments are
+ * contiguous in rank order, so after a node barrier the node leader sees
+ * the whole node's cities as one array and merges the node totals with
+ * plain loads, without any intra-node messages. Only leaders then join
+ * the inter-node step: node totals are combined with MPI_Reduce and the
+ * node arrays gathered with MPI_Gatherv straight out of shared memory, so
+ * rank 0 receives one message per node instead of one per rank. Returns
+ * the number of cities on rank 0; *nodes and *bytes_moved are set there.
+ */
+static int gather_hierarchical(const CityStats* local, int count, MPI_Datatype city_type, int rank,
+                               Arena* arena, CityStats** all_results, GlobalTotals* totals,
+                               int* nodes, long* bytes_moved) {
+    MPI_Comm node_comm, leader_comm;
+    int node_rank, node_size;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+    MPI_Comm_split(MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &leader_comm);
+
+    CityStats* segment;
+    MPI_Win win;
+    MPI_Win_allocate_shared((MPI_Aint)count * sizeof(CityStats), sizeof(CityStats), MPI_INFO_NULL,
+                            node_comm, &segment, &win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+    if (count > 0) memcpy(segment, local, count * sizeof(CityStats));
+    MPI_Win_sync(win);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(win);
+
+    int total = 0;
+    if (node_rank == 0) {
+        // Node-local merge: read every segment in place
+        int node_total = 0;
+        for (int r = 0; r < node_size; r++) {
+            MPI_Aint seg_size;
+            int disp_unit;
+            CityStats* base;
+            MPI_Win_shared_query(win, r, &seg_size, &disp_unit, &base);
+            node_total += (int)(seg_size / sizeof(CityStats));
+        }
+        CityStats* node_cities = NULL;
+        if (node_total > 0) {
+            MPI_Aint seg_size;
+            int disp_unit;
+            MPI_Win_shared_query(win, MPI_PROC_NULL, &seg_size, &disp_unit, &node_cities);
+        }
+
+        GlobalTotals node_totals;
+        compute_totals(node_cities, node_total, &node_totals);
+        reduce_totals(&node_totals, totals, leader_comm);
+
+        // Inter-node gather among leaders only
+        int leader_rank, leaders;
+        MPI_Comm_rank(leader_comm, &leader_rank);
+        MPI_Comm_size(leader_comm, &leaders);
+        int* counts = NULL;
+        int* displs = NULL;
+        if (leader_rank == 0) {
+            counts = arena_alloc(arena, leaders * sizeof(int));
+            displs = arena_alloc(arena, leaders * sizeof(int));
+            if (!counts || !displs) {
+                fprintf(stderr, "Rank 0: arena exhausted for gather arrays\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        }
+        MPI_Gather(&node_total, 1, MPI_INT, counts, 1, MPI_INT, 0, leader_comm);
+        if (leader_rank == 0) {
+            for (int l = 0; l < leaders; l++) {
+                displs[l] = total;
+                total += counts[l];
             }
+            *all_results = arena_alloc(arena, (total > 0 ? total : 1) * sizeof(CityStats));
+            if (!*all_results) {
+                fprintf(stderr, "Rank 0: arena exhausted for all_results\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            *nodes = leaders;
+            *bytes_moved = (long)(total - node_total) * sizeof(CityStats);
         }
+        MPI_Gatherv(node_cities, node_total, city_type, leader_rank == 0 ? *all_results : NULL,
+                    counts, displs, city_type, 0, leader_comm);
+        MPI_Comm_free(&leader_comm);
     }
 
-    printf("TOP 10 HOTTEST CITIES (by average temperature):\n");
-    printf("%-25s %10s %10s %10s %12s\n", "City", "Avg(°C)", "Min(°C)", "Max(°C)", "Records");
-    printf("--------------------------------------------------------------------------------\n");
-    for (int i = 0; i < 10 && i < city_count; i++) {
-        CityStats* c = &cities[i];
-        if (c->temp_count > 0) {
-            printf("%-25s %10.2f %10.2f %10.2f %12d\n",
-                   c->name,
-                   c->temp_sum / c->temp_count,
-                   c->temp_min,
-                   c->temp_max,
-                   c->record_count);
+    MPI_Win_unlock_all(win);
+    MPI_Win_free(&win);
+    MPI_Comm_free(&node_comm);
+    return total;
+}
+
+// LEB128 unsigned varint
+static unsigned char* put_varint(unsigned char* p, unsigned long v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+static const unsigned char* get_varint(const unsigned char* p, unsigned long* v) {
+    unsigned long result = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        result |= (unsigned long)(*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+    *v = result | ((unsigned long)*p++ << shift);
+    return p;
+}
+
+static unsigned char* put_real(unsigned char* p, double v, int f32) {
+    if (f32) {
+        float f = (float)v;
+        memcpy(p, &f, sizeof(f));
+        return p + sizeof(f);
+    }
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+static const unsigned char* get_real(const unsigned char* p, double* v, int f32) {
+    if (f32) {
+        float f;
+        memcpy(&f, p, sizeof(f));
+        *v = f;
+        return p + sizeof(f);
+    }
+    memcpy(v, p, sizeof(*v));
+    return p + sizeof(*v);
+}
+
+/**
+ * Serialize one city: city ID instead of the 128-byte name, counts as
+ * varints, sums/extremes as doubles (or floats with f32 - lossy, for
+ * bandwidth experiments). Monthly sums are skipped for empty months.
+ */
+static unsigned char* pack_city(unsigned char* p, const CityStats* c, int city_id, int f32) {
+    p = put_varint(p, city_id);
+    p = put_varint(p, c->record_count);
+    p = put_varint(p, c->temp_count);
+    p = put_varint(p, c->precip_count);
+    p = put_real(p, c->temp_sum, f32);
+    p = put_real(p, c->temp_min, f32);
+    p = put_real(p, c->temp_max, f32);
+    p = put_real(p, c->precip_sum, f32);
+    for (int m = 0; m < 12; m++) {
+        p = put_varint(p, c->monthly_temp_count[m]);
+        if (c->monthly_temp_count[m] > 0) p = put_real(p, c->monthly_temp_sum[m], f32);
+    }
+    return p;
+}
+
+static const unsigned char* unpack_city(const unsigned char* p, CityStats* c, int f32) {
+    unsigned long v;
+    p = get_varint(p, &v);
+    strncpy(c->name, file_list_name(&file_list, v), MAX_NAME - 1);
+    c->name[MAX_NAME - 1] = '\0';
+    p = get_varint(p, &v); c->record_count = (int)v;
+    p = get_varint(p, &v); c->temp_count = (int)v;
+    p = get_varint(p, &v); c->precip_count = (int)v;
+    p = get_real(p, &c->temp_sum, f32);
+    p = get_real(p, &c->temp_min, f32);
+    p = get_real(p, &c->temp_max, f32);
+    p = get_real(p, &c->precip_sum, f32);
+    if (f32 && c->temp_count == 0) {
+        // float cannot hold the DBL_MAX sentinels
+        c->temp_min = DBL_MAX;
+        c->temp_max = -DBL_MAX;
+    }
+    for (int m = 0; m < 12; m++) {
+        p = get_varint(p, &v);
+        c->monthly_temp_count[m] = (int)v;
+        c->monthly_temp_sum[m] = 0;
+        if (v > 0) p = get_real(p, &c->monthly_temp_sum[m], f32);
+    }
+    return p;
+}
+
+/**
+ * Gather all results to rank 0 in the packed wire format
+ *
+ * Each rank serializes its cities into one contiguous byte buffer; byte
+ * counts and buffers then travel as MPI_BYTE (MPI_Gather + MPI_Gatherv, or
+ * MPI_Igatherv in nonblocking mode), so MPI never walks a struct datatype.
+ * Rank 0 decodes into *all_results. Returns the number of cities on rank 0
+ * and stores the bytes moved in *bytes_moved.
+ */
+static int gather_packed(const CityStats* local, const int* file_ids, int count, int f32, int nonblocking,
+                         int rank, int size, Arena* arena, CityStats** all_results, long* bytes_moved) {
+    unsigned char* sendbuf = arena_alloc(arena, (size_t)count * PACKED_CITY_MAX + 1);
+    if (!sendbuf) {
+        fprintf(stderr, "Rank %d: arena exhausted for packed buffer\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    unsigned char* p = sendbuf;
+    for (int i = 0; i < count; i++) {
+        p = pack_city(p, &local[i], file_ids[i], f32);
+    }
+    int send_bytes = (int)(p - sendbuf);
+
+    int* byte_counts = NULL;
+    int* displs = NULL;
+    unsigned char* recvbuf = NULL;
+    long total_bytes = 0;
+    if (rank == 0) {
+        byte_counts = arena_alloc(arena, size * sizeof(int));
+        displs = arena_alloc(arena, size * sizeof(int));
+        if (!byte_counts || !displs) {
+            fprintf(stderr, "Rank 0: arena exhausted for gather arrays\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
         }
     }
 
-    printf("\nTOP 10 COLDEST CITIES (by average temperature):\n");
-    printf("%-25s %10s %10s %10s %12s\n", "City", "Avg(°C)", "Min(°C)", "Max(°C)", "Records");
-    printf("--------------------------------------------------------------------------------\n");
-    for (int i = city_count - 1; i >= 0 && i >= city_count - 10; i--) {
-        CityStats* c = &cities[i];
-        if (c->temp_count > 0) {
-            printf("%-25s %10.2f %10.2f %10.2f %12d\n",
-                   c->name,
-                   c->temp_sum / c->temp_count,
-                   c->temp_min,
-                   c->temp_max,
-                   c->record_count);
+    MPI_Gather(&send_bytes, 1, MPI_INT, byte_counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) {
+            displs[r] = (int)total_bytes;
+            total_bytes += byte_counts[r];
+        }
+        recvbuf = arena_alloc(arena, total_bytes + 1);
+        *all_results = arena_alloc(arena, (size_t)file_list.count * sizeof(CityStats));
+        if (!recvbuf || (!*all_results && file_list.count > 0)) {
+            fprintf(stderr, "Rank 0: arena exhausted for packed results\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    if (nonblocking) {
+        MPI_Request request;
+        MPI_Igatherv(sendbuf, send_bytes, MPI_BYTE, recvbuf, byte_counts, displs, MPI_BYTE,
+                     0, MPI_COMM_WORLD, &request);
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+    } else {
+        MPI_Gatherv(sendbuf, send_bytes, MPI_BYTE, recvbuf, byte_counts, displs, MPI_BYTE,
+                    0, MPI_COMM_WORLD);
+    }
+
+    int total = 0;
+    if (rank == 0) {
+        const unsigned char* q = recvbuf;
+        while (q < recvbuf + total_bytes) {
+            q = unpack_city(q, &(*all_results)[total++], f32);
+        }
+    }
+
+    *bytes_moved = total_bytes;
+    return total;
+}
+
+/**
+ * Top-N daily records ("--days"): per-rank selection, then rank 0 merges
+ *
+ * recs holds this rank's best records, best first (a merged thread heap
+ * or the head of its sample-sort bucket). Only min(n, count) of them are
+ * sent, so rank 0 receives at most ranks * n candidates. Returns the
+ * candidate count on rank 0, whose *top holds the final N best first.
+ */
+static int gather_top_days(const DayRecord* recs, long count, long n, MPI_Datatype day_type, int rank,
+                           int size, DaySink* top) {
+    int send = (int)(count < n ? count : n);
+    int* counts = NULL;
+    int* displs = NULL;
+    DayRecord* cand = NULL;
+    int total = 0;
+    if (rank == 0) {
+        counts = malloc(size * sizeof(int));
+        displs = malloc(size * sizeof(int));
+        if (!counts || !displs) {
+            fprintf(stderr, "Rank 0: malloc failed for day candidates\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    MPI_Gather(&send, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) {
+            displs[r] = total;
+            total += counts[r];
         }
+        cand = malloc((total > 0 ? total : 1) * sizeof(DayRecord));
+        if (!cand) {
+            fprintf(stderr, "Rank 0: malloc failed for day candidates\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    MPI_Gatherv(recs, send, day_type, cand, counts, displs, day_type, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        for (int i = 0; i < total; i++) day_sink_push(top, &cand[i]);
+        day_sink_sort(top);
+        free(cand);
+        free(counts);
+        free(displs);
+    }
+    return total;
+}
+
+// First index in sorted recs that does not rank before split
+static long day_lower_bound(const DayRecord* recs, long count, const DayRecord* split) {
+    long lo = 0, hi = count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (day_compare(&recs[mid], split) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Distributed sample sort of every rank's daily records ("--days-sort")
+ *
+ * Each rank sorts its own records and contributes up to DAYS_SAMPLES
+ * evenly spaced samples; every rank picks the same size-1 splitters from
+ * the allgathered samples. One MPI_Alltoallv then routes each record to
+ * its bucket's rank, which sorts what it received: rank r ends up with the
+ * r-th slice of the global order and never more than its own bucket.
+ * sink->recs is replaced by the bucket. Returns records sent to other ranks.
+ */
+static long sample_sort_days(DaySink* sink, MPI_Datatype day_type, int rank, int size) {
+    day_sink_sort(sink);
+    long count = sink->count;
+
+    // Regular samples from the locally sorted records
+    int nsamp = count < DAYS_SAMPLES ? (int)count : DAYS_SAMPLES;
+    DayRecord samples[DAYS_SAMPLES];
+    for (int i = 0; i < nsamp; i++) {
+        samples[i] = sink->recs[(2 * i + 1) * count / (2 * nsamp)];
     }
 
-    printf("\nTOP 10 WETTEST CITIES (by total precipitation):\n");
-    printf("%-25s %15s %12s\n", "City", "Total(mm)", "Days w/Rain");
+    int* samp_counts = malloc(size * sizeof(int));
+    int* samp_displs = malloc(size * sizeof(int));
+    int* send_counts = malloc(size * sizeof(int));
+    int* send_displs = malloc(size * sizeof(int));
+    int* recv_counts = malloc(size * sizeof(int));
+    int* recv_displs = malloc(size * sizeof(int));
+    if (!samp_counts || !samp_displs || !send_counts || !send_displs || !recv_counts || !recv_displs) {
+        fprintf(stderr, "Rank %d: malloc failed for sample sort\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Allgather(&nsamp, 1, MPI_INT, samp_counts, 1, MPI_INT, MPI_COMM_WORLD);
+    int total_samples = 0;
+    for (int r = 0; r < size; r++) {
+        samp_displs[r] = total_samples;
+        total_samples += samp_counts[r];
+    }
+    DayRecord* all_samples = malloc((total_samples > 0 ? total_samples : 1) * sizeof(DayRecord));
+    if (!all_samples) {
+        fprintf(stderr, "Rank %d: malloc failed for samples\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Allgatherv(samples, nsamp, day_type, all_samples, samp_counts, samp_displs, day_type,
+                   MPI_COMM_WORLD);
+    if (total_samples > 1) qsort(all_samples, total_samples, sizeof(DayRecord), day_compare);
+
+    // Bucket d gets records from splitter d-1 (inclusive) to splitter d
+    long start = 0;
+    long sent = 0;
+    for (int d = 0; d < size; d++) {
+        long end = count;
+        if (d < size - 1 && total_samples > 0) {
+            long at = (long)(d + 1) * total_samples / size;
+            end = day_lower_bound(sink->recs, count, &all_samples[at]);
+            if (end < start) end = start;
+        }
+        send_counts[d] = (int)(end - start);
+        send_displs[d] = (int)start;
+        if (d != rank) sent += end - start;
+        start = end;
+    }
+    free(all_samples);
+
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, MPI_COMM_WORLD);
+    long bucket = 0;
+    for (int r = 0; r < size; r++) {
+        recv_displs[r] = (int)bucket;
+        bucket += recv_counts[r];
+    }
+    DayRecord* recv = malloc((bucket > 0 ? bucket : 1) * sizeof(DayRecord));
+    if (!recv) {
+        fprintf(stderr, "Rank %d: malloc failed for sort bucket\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Alltoallv(sink->recs, send_counts, send_displs, day_type,
+                  recv, recv_counts, recv_displs, day_type, MPI_COMM_WORLD);
+
+    free(sink->recs);
+    sink->recs = recv;
+    sink->count = sink->capacity = bucket;
+    day_sink_sort(sink);
+
+    free(samp_counts);
+    free(samp_displs);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+    return sent;
+}
+
+// Write this rank's sorted bucket to <prefix>.<rank>.csv; concatenating the
+// files in rank order gives the global order. Returns 0 on success.
+static int write_sorted_days(const char* prefix, const DaySink* sink, long global_offset, int rank) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.%d.csv", prefix, rank);
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Rank %d: cannot write %s\n", rank, path);
+        return -1;
+    }
+    if (rank == 0) fprintf(fp, "rank,city_name,date,value\n");
+    for (long i = 0; i < sink->count; i++) {
+        const DayRecord* d = &sink->recs[i];
+        fprintf(fp, "%ld,%s,%04d-%02d-%02d,%.2f\n", global_offset + i + 1, file_list_name(&file_list, d->city),
+                d->date / 10000, d->date / 100 % 100, d->date % 100, day_value(d, sink->metric));
+    }
+    fclose(fp);
+    return 0;
+}
+
+static void print_day_ranking(const DaySink* top, long n) {
+    printf("\n========== TOP %ld %s DAYS ==========\n", n, day_metric_name(top->metric));
+    printf("%-6s %-30s %12s %12s\n", "Rank", "City", "Date",
+           top->metric == DAYS_WETTEST ? "Precip (mm)" : "Avg Temp");
     printf("--------------------------------------------------------------------------------\n");
+    for (long i = 0; i < top->count; i++) {
+        const DayRecord* d = &top->recs[i];
+        char date[16];
+        snprintf(date, sizeof(date), "%04d-%02d-%02d", d->date / 10000, d->date / 100 % 100, d->date % 100);
+        printf("%-6ld %-30s %12s %12.2f\n", i + 1, file_list_name(&file_list, d->city), date, day_value(d, top->metric));
+    }
+}
+
+typedef struct {
+    int batches;         // batches rank 0 received from other ranks
+    int hidden;          // ... of which completed while rank 0 was still computing
+    long bytes;
+    long hidden_bytes;
+    double drain_time;   // rank 0 wait for batches still in flight after its own work
+    double send_wait;    // slowest sender's final MPI_Waitall
+} StreamStats;
+
+// Fold a batch of finished cities into the running totals
+static void fold_totals(GlobalTotals* totals, const CityStats* cities, int n) {
+    GlobalTotals part;
+    int one = 1;
+    compute_totals(cities, n, &part);
+    merge_totals(&part, totals, &one, NULL);
+}
+
+/**
+ * Streaming result collection ("nonblocking" comm_mode, struct wire)
+ *
+ * Files are processed in batches of STREAM_BATCH. Other ranks MPI_Isend
+ * each finished batch straight from their result array and keep parsing.
+ * Rank 0 learns every rank's file count up front, so it posts one
+ * MPI_Irecv per expected batch directly into that batch's final slot in
+ * *all_results. Every batch uses STREAM_TAG: messages from one source on
+ * one tag match receives in posting order, so the k-th receive posted for
+ * a rank gets its k-th batch without a per-batch tag (which could exceed
+ * MPI_TAG_UB on large inputs). Between its own batches rank 0 folds
+ * whatever MPI_Testsome reports complete into the running totals. Only
+ * batches still in flight when rank 0 runs out of its own files are
+ * waited for. Returns the records processed by this rank.
+ */
+static long stream_results(const int* files, int count, Arena* worker_arenas, MPI_Datatype city_type,
+                           int rank, int size, Arena* arena, CityStats** all_results, int* total_cities,
+                           GlobalTotals* totals, StreamStats* stats) {
+    int* counts = NULL;
+    int* displs = NULL;
+    MPI_Request* reqs = NULL;
+    int* req_slot = NULL;
+    int* req_len = NULL;
+    int* done_idx = NULL;
+    int nreq = 0;
+    CityStats* local;
+    int type_size;
+    MPI_Type_size(city_type, &type_size);
+    memset(stats, 0, sizeof(*stats));
 
-    for (int i = 0; i < city_count - 1; i++) {
-        for (int j = i + 1; j < city_count; j++) {
-            if (cities[j].precip_sum > cities[i].precip_sum) {
-                CityStats temp = cities[i];
-                cities[i] = cities[j];
-                cities[j] = temp;
+    if (rank == 0) {
+        counts = arena_alloc(arena, size * sizeof(int));
+        displs = arena_alloc(arena, size * sizeof(int));
+        if (!counts || !displs) {
+            fprintf(stderr, "Rank 0: arena exhausted for gather arrays\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        int total = 0;
+        for (int r = 0; r < size; r++) {
+            displs[r] = total;
+            total += counts[r];
+            if (r > 0) nreq += (counts[r] + STREAM_BATCH - 1) / STREAM_BATCH;
+        }
+        *total_cities = total;
+        *all_results = arena_alloc(arena, (total > 0 ? total : 1) * sizeof(CityStats));
+        reqs = arena_alloc(arena, (nreq + 1) * sizeof(MPI_Request));
+        req_slot = arena_alloc(arena, (nreq + 1) * sizeof(int));
+        req_len = arena_alloc(arena, (nreq + 1) * sizeof(int));
+        done_idx = arena_alloc(arena, (nreq + 1) * sizeof(int));
+        if (!*all_results || !reqs || !req_slot || !req_len || !done_idx) {
+            fprintf(stderr, "Rank 0: arena exhausted for stream receives\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+        int q = 0;
+        for (int r = 1; r < size; r++) {
+            for (int b = 0; b * STREAM_BATCH < counts[r]; b++) {
+                int n = counts[r] - b * STREAM_BATCH;
+                if (n > STREAM_BATCH) n = STREAM_BATCH;
+                req_slot[q] = displs[r] + b * STREAM_BATCH;
+                req_len[q] = n;
+                MPI_Irecv(*all_results + req_slot[q], n, city_type, r, STREAM_TAG, MPI_COMM_WORLD, &reqs[q]);
+                q++;
             }
         }
+        local = *all_results;   // rank 0's own slots come first
+        compute_totals(NULL, 0, totals);
+    } else {
+        int nbatch = (count + STREAM_BATCH - 1) / STREAM_BATCH;
+        local = arena_alloc(arena, (count > 0 ? count : 1) * sizeof(CityStats));
+        reqs = arena_alloc(arena, (nbatch + 1) * sizeof(MPI_Request));
+        if (!local || !reqs) {
+            fprintf(stderr, "Rank %d: arena exhausted for stream sends\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
     }
 
-    for (int i = 0; i < 10 && i < city_count; i++) {
-        CityStats* c = &cities[i];
-        printf("%-25s %15.2f %12d\n", c->name, c->precip_sum, c->precip_count);
+    long records = 0;
+    int nsent = 0;
+    for (int b = 0; b * STREAM_BATCH < count; b++) {
+        int first = b * STREAM_BATCH;
+        int n = count - first < STREAM_BATCH ? count - first : STREAM_BATCH;
+        records += process_file_list(files + first, n, local + first, worker_arenas);
+
+        phase_switch(&phase_timers[0], PHASE_REDUCE);
+        if (rank == 0) {
+            fold_totals(totals, local + first, n);
+            int outcount;
+            MPI_Testsome(nreq, reqs, &outcount, done_idx, MPI_STATUSES_IGNORE);
+            if (outcount == MPI_UNDEFINED) outcount = 0;
+            for (int i = 0; i < outcount; i++) {
+                int q = done_idx[i];
+                fold_totals(totals, *all_results + req_slot[q], req_len[q]);
+                stats->hidden++;
+                stats->hidden_bytes += (long)req_len[q] * type_size;
+            }
+        } else {
+            MPI_Isend(local + first, n, city_type, 0, STREAM_TAG, MPI_COMM_WORLD, &reqs[nsent++]);
+            int flag;
+            MPI_Testall(nsent, reqs, &flag, MPI_STATUSES_IGNORE);  // drive progress
+        }
+        phase_switch(&phase_timers[0], PHASE_NONE);
     }
 
-    printf("\n========== OVERALL STATISTICS ==========\n");
-    long total_records = 0;
-    double global_temp_sum = 0;
-    int global_temp_count = 0;
+    phase_switch(&phase_timers[0], PHASE_REDUCE);
+    double t0 = phase_clock();
+    if (rank == 0) {
+        for (;;) {
+            int outcount;
+            MPI_Waitsome(nreq, reqs, &outcount, done_idx, MPI_STATUSES_IGNORE);
+            if (outcount == MPI_UNDEFINED) break;
+            for (int i = 0; i < outcount; i++) {
+                int q = done_idx[i];
+                fold_totals(totals, *all_results + req_slot[q], req_len[q]);
+            }
+        }
+        stats->drain_time = phase_clock() - t0;
+        stats->batches = nreq;
+        for (int q = 0; q < nreq; q++) stats->bytes += (long)req_len[q] * type_size;
+    } else {
+        MPI_Waitall(nsent, reqs, MPI_STATUSES_IGNORE);
+    }
+
+    double wait = phase_clock() - t0;
+    if (rank == 0) wait = 0;
+    MPI_Reduce(&wait, &stats->send_wait, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    phase_switch(&phase_timers[0], PHASE_NONE);
+    return records;
+}
+
+// Open-addressing map from city name to its partial CityStats
+typedef struct {
+    CityStats* cities;
+    int count;
+    int capacity;
+    int* slots;      // index into cities, -1 = empty
+    int nslots;      // power of two, kept >= 2 * capacity
+} CityTable;
+
+static void city_table_init(CityTable* t) {
+    t->count = 0;
+    t->capacity = 256;
+    t->nslots = 512;
+    t->cities = malloc(t->capacity * sizeof(CityStats));
+    t->slots = malloc(t->nslots * sizeof(int));
+    if (!t->cities || !t->slots) {
+        fprintf(stderr, "malloc failed for city table\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    memset(t->slots, -1, t->nslots * sizeof(int));
+}
+
+static void city_table_free(CityTable* t) {
+    free(t->cities);
+    free(t->slots);
+}
+
+static unsigned int hash_name(const char* name) {
+    unsigned int h = 2166136261u;
+    for (; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Index of a city by name, adding an empty aggregate if it is new
+// (indices stay valid when the table grows, pointers do not)
+static int city_table_index(CityTable* t, const char* name) {
+    unsigned int mask = t->nslots - 1;
+    unsigned int i = hash_name(name) & mask;
+    while (t->slots[i] >= 0) {
+        if (strcmp(t->cities[t->slots[i]].name, name) == 0) return t->slots[i];
+        i = (i + 1) & mask;
+    }
+
+    if (t->count == t->capacity) {
+        t->capacity *= 2;
+        t->nslots *= 2;
+        t->cities = realloc(t->cities, t->capacity * sizeof(CityStats));
+        t->slots = realloc(t->slots, t->nslots * sizeof(int));
+        if (!t->cities || !t->slots) {
+            fprintf(stderr, "realloc failed for city table\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        memset(t->slots, -1, t->nslots * sizeof(int));
+        mask = t->nslots - 1;
+        for (int c = 0; c < t->count; c++) {
+            unsigned int j = hash_name(t->cities[c].name) & mask;
+            while (t->slots[j] >= 0) j = (j + 1) & mask;
+            t->slots[j] = c;
+        }
+        i = hash_name(name) & mask;
+        while (t->slots[i] >= 0) i = (i + 1) & mask;
+    }
+
+    CityStats* city = &t->cities[t->count];
+    strncpy(city->name, name, MAX_NAME - 1);
+    city->name[MAX_NAME - 1] = '\0';
+    init_city_stats(city);
+    t->slots[i] = t->count;
+    return t->count++;
+}
+
+// Find a city by name, adding an empty aggregate if it is new
+static CityStats* city_table_get(CityTable* t, const char* name) {
+    return &t->cities[city_table_index(t, name)];
+}
+
+// Lines of the concatenated file waiting to be parsed and aggregated
+typedef struct {
+    const char* lines[PHASE_BATCH];
+    ParsedRecord recs[PHASE_BATCH];
+    int city[PHASE_BATCH];   // table index, -1 = header line
+    int count;
+} LineBatch;
+
+// Parse the batched lines, then aggregate them, each pass charged to its
+// phase (the caller is in the parse phase)
+static void flush_lines(CityTable* t, LineBatch* b, PhaseTimer* pt) {
+    char name[MAX_NAME];
+    for (int i = 0; i < b->count; i++) {
+        get_field(b->lines[i], FIELD_CITY, name, sizeof(name));
+        b->city[i] = -1;
+        if (name[0] == '\0' || strcmp(name, "city_name") == 0) continue;
+        b->city[i] = city_table_index(t, name);
+        parse_record(b->lines[i], &b->recs[i], 0);
+    }
+
+    phase_switch(pt, PHASE_AGGREGATE);
+    for (int i = 0; i < b->count; i++) {
+        if (b->city[i] >= 0) aggregate_record(&t->cities[b->city[i]], &b->recs[i], NULL, 0);
+    }
+    b->count = 0;
+    phase_switch(pt, PHASE_PARSE);
+}
+
+// Queue one line (header lines are skipped); it must stay intact until flushed
+static void add_line(CityTable* t, LineBatch* b, const char* line, PhaseTimer* pt) {
+    b->lines[b->count++] = line;
+    if (b->count == PHASE_BATCH) flush_lines(t, b, pt);
+}
+
+// Aggregate every complete line in buf[0..len); returns the offset of the
+// trailing partial line. Lines longer than MAX_LINE are dropped whole, as
+// they are when they straddle a block, so results do not depend on where
+// the block boundaries fall.
+static long accumulate_block(CityTable* t, LineBatch* b, char* buf, long len, PhaseTimer* pt) {
+    phase_switch(pt, PHASE_PARSE);
+    long pos = 0;
+    while (pos < len) {
+        char* nl = memchr(buf + pos, '\n', len - pos);
+        if (!nl) break;
+        *nl = '\0';
+        if (nl - (buf + pos) <= MAX_LINE) add_line(t, b, buf + pos, pt);
+        pos = nl - buf + 1;
+    }
+    flush_lines(t, b, pt);
+    return pos;
+}
+
+// First line start at or after byte `from`: just past the first '\n' at or
+// after from - 1, or file_size if there is none
+static MPI_Offset next_line_start(MPI_File fh, MPI_Offset from, MPI_Offset file_size) {
+    if (from <= 0) return 0;
+    char probe[MPIIO_PROBE];
+    for (MPI_Offset at = from - 1; at < file_size; at += MPIIO_PROBE) {
+        int n = file_size - at < MPIIO_PROBE ? (int)(file_size - at) : MPIIO_PROBE;
+        MPI_File_read_at(fh, at, probe, n, MPI_BYTE, MPI_STATUS_IGNORE);
+        char* nl = memchr(probe, '\n', n);
+        if (nl) return at + (nl - probe) + 1;
+    }
+    return file_size;
+}
+
+/**
+ * MPI-IO mode: one concatenated CSV file instead of one file per city
+ *
+ * Rank r starts at the first line that begins at or after byte r*N/P and
+ * reads up to where rank r+1 starts, in MPIIO_BLOCK pieces with collective
+ * MPI_File_read_at_all, so every line is read whole by exactly one rank.
+ * A rank whose share holds no line start (lines longer than N/P) is left
+ * with an empty range and contributes nothing. Lines are grouped by
+ * city_name into per-station partials, which rank 0 gathers and merges by
+ * name. Opening the file and placing the boundaries belong to the
+ * enumerate phase; the main thread's timer is used.
+ */
+static int run_mpiio(const char* path, int rank, int size, double startup_start) {
+    PhaseTimer* pt = &phase_timers[0];
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "Failed to open %s with MPI-IO\n", path);
+        return 1;
+    }
+
+    MPI_Offset file_size;
+    MPI_File_get_size(fh, &file_size);
+
+    // My range ends where the next rank's begins
+    int left = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int right = rank < size - 1 ? rank + 1 : MPI_PROC_NULL;
+    MPI_Offset begin = next_line_start(fh, file_size * rank / size, file_size);
+    MPI_Offset end = file_size;
+    MPI_Sendrecv(&begin, 1, MPI_OFFSET, left, 0, &end, 1, MPI_OFFSET, right, 0, MPI_COMM_WORLD,
+                 MPI_STATUS_IGNORE);
+
+    // Every rank makes the same number of collective calls
+    MPI_Offset range = end - begin, max_range;
+    MPI_Allreduce(&range, &max_range, 1, MPI_OFFSET, MPI_MAX, MPI_COMM_WORLD);
+    int nblocks = (int)((max_range + MPIIO_BLOCK - 1) / MPIIO_BLOCK);
+    double startup_time = phase_clock() - startup_start;
+    phase_switch(pt, PHASE_NONE);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = phase_clock();
+
+    char* buf = malloc(MAX_LINE + MPIIO_BLOCK + 1);
+    LineBatch* batch = malloc(sizeof(LineBatch));
+    if (!buf || !batch) {
+        fprintf(stderr, "Rank %d: malloc failed for MPI-IO buffers\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    CityTable table;
+    city_table_init(&table);
+    batch->count = 0;
+
+    long carry = 0;          // partial line kept at the front of buf
+    int skipping = 0;        // inside an overlong line: discard up to its '\n'
+    double read_time = 0;
+
+    for (int b = 0; b < nblocks; b++) {
+        MPI_Offset offset = begin + (MPI_Offset)b * MPIIO_BLOCK;
+        int count = 0;
+        if (offset < end) {
+            count = end - offset < MPIIO_BLOCK ? (int)(end - offset) : MPIIO_BLOCK;
+        }
 
-    for (int i = 0; i < city_count; i++) {
-        total_records += cities[i].record_count;
-        global_temp_sum += cities[i].temp_sum;
-        global_temp_count += cities[i].temp_count;
+        phase_switch(pt, PHASE_IO);
+        double t0 = phase_clock();
+        MPI_Status status;
+        MPI_File_read_at_all(fh, offset, buf + carry, count, MPI_BYTE, &status);
+        read_time += phase_clock() - t0;
+        if (count == 0) continue;
+
+        // carry is 0 while skipping, so the rest of the line is at buf[0]
+        long start = 0;
+        if (skipping) {
+            char* nl = memchr(buf, '\n', count);
+            if (!nl) continue;
+            start = nl - buf + 1;
+            skipping = 0;
+        }
+
+        long len = carry + count;
+        long done = start + accumulate_block(&table, batch, buf + start, len - start, pt);
+        carry = len - done;
+        if (carry > MAX_LINE) {  // overlong line: drop it through its newline
+            carry = 0;
+            skipping = 1;
+        }
+        memmove(buf, buf + done, carry);
+    }
+    phase_switch(pt, PHASE_IO);
+    MPI_File_close(&fh);
+
+    // The last line of the file may lack its newline
+    if (carry > 0) {
+        buf[carry] = '\0';
+        phase_switch(pt, PHASE_PARSE);
+        add_line(&table, batch, buf, pt);
+        flush_lines(&table, batch, pt);
+    }
+
+    free(buf);
+    free(batch);
+
+    // Merge per-station partials on rank 0
+    phase_switch(pt, PHASE_REDUCE);
+    MPI_Datatype city_type = create_city_type();
+    int* counts = NULL;
+    int* displs = NULL;
+    CityStats* partials = NULL;
+    int total_partials = 0;
+    if (rank == 0) {
+        counts = malloc(size * sizeof(int));
+        displs = malloc(size * sizeof(int));
+        if (!counts || !displs) {
+            fprintf(stderr, "Rank 0: malloc failed for gather arrays\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    MPI_Gather(&table.count, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) {
+            displs[r] = total_partials;
+            total_partials += counts[r];
+        }
+        partials = malloc((total_partials > 0 ? total_partials : 1) * sizeof(CityStats));
+        if (!partials) {
+            fprintf(stderr, "Rank 0: malloc failed for partials\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    MPI_Gatherv(table.cities, table.count, city_type, partials, counts, displs, city_type,
+                0, MPI_COMM_WORLD);
+
+    CityTable merged;
+    if (rank == 0) {
+        city_table_init(&merged);
+        for (int i = 0; i < total_partials; i++) {
+            merge_city_stats(city_table_get(&merged, partials[i].name), &partials[i]);
+        }
+    }
+
+    double elapsed = phase_clock() - start_time;
+    phase_switch(pt, PHASE_NONE);
+    double max_elapsed, max_read, max_startup;
+    MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&read_time, &max_read, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&startup_time, &max_startup, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        phase_switch(pt, PHASE_REPORT);
+        GlobalTotals totals;
+        compute_totals(merged.cities, merged.count, &totals);
+        print_rankings(merged.cities, merged.count);
+        print_overall(&totals);
+
+        printf("\n========== PERFORMANCE ==========\n");
+        printf("Startup time (open): %.3f seconds\n", max_startup);
+        printf("Processing time: %.3f seconds\n", max_elapsed);
+        printf("Collective read time (max): %.3f seconds\n", max_read);
+        printf("File size: %.2f MB (%.2f MB per rank)\n", file_size / 1e6, file_size / 1e6 / size);
+        printf("Station partials merged: %d\n", total_partials);
+        printf("Cities processed: %ld\n", totals.cities);
+        printf("Processes used: %d\n", size);
+        printf("Throughput: %.2f cities/second\n", totals.cities / max_elapsed);
+        printf("Record throughput: %.2f records/second\n", totals.records / max_elapsed);
+        phase_switch(pt, PHASE_NONE);
+
+        city_table_free(&merged);
+        free(partials);
+        free(counts);
+        free(displs);
     }
+    print_phase_table(pt, 1, rank, size);
 
-    printf("Total cities analyzed: %d\n", city_count);
-    printf("Total records processed: %ld\n", total_records);
-    printf("Global average temperature: %.2f°C\n",
-           global_temp_count > 0 ? global_temp_sum / global_temp_count : 0);
+    city_table_free(&table);
+    MPI_Type_free(&city_type);
+    return 0;
 }
 
+// In the unified front end (frontend/weather.c) this is the backend entry point
+#ifdef WEATHER_FRONTEND
+#define main weather_mpi_main
+#endif
+
 int main(int argc, char* argv[]) {
     int rank, size;
 
+#ifdef _OPENMP
+    // Hybrid build: only the master thread makes MPI calls
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    if (provided < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "MPI library does not support MPI_THREAD_FUNNELED\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+#else
     MPI_Init(&argc, &argv);
+#endif
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    if (argc < 2) {
+    // Split --options from positional arguments
+    const char* pos[5];
+    int npos = 0;
+    WireFormat wire = WIRE_STRUCT;
+    const char* wire_name = "struct";
+    const char* ckpt_dir = NULL;
+    double ckpt_interval = CKPT_DEFAULT_INTERVAL;
+    int resume = 0;
+    int days_query = 0;
+    DayMetric days_metric = DAYS_HOTTEST;
+    long days_n = DAYS_DEFAULT_N;
+    const char* days_sort = NULL;
+    int counters = 0;
+    BenchConfig bench;
+    bench_init(&bench);
+    for (int i = 1; i < argc; i++) {
+        if (bench_parse_option(&bench, argc, argv, &i)) {
+            continue;
+        } else if (strcmp(argv[i], "--wire") == 0 && i + 1 < argc) {
+            wire_name = argv[++i];
+            if (strcmp(wire_name, "packed") == 0) wire = WIRE_PACKED;
+            else if (strcmp(wire_name, "packed-f32") == 0) wire = WIRE_PACKED_F32;
+            else wire_name = "struct";
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            ckpt_dir = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+            ckpt_interval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = 1;
+        } else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            days_query = parse_day_metric(argv[++i], &days_metric) == 0;
+        } else if (strcmp(argv[i], "--days-n") == 0 && i + 1 < argc) {
+            days_n = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--days-sort") == 0 && i + 1 < argc) {
+            days_sort = argv[++i];
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            counters = 1;
+        } else if (npos < 5) {
+            pos[npos++] = argv[i];
+        }
+    }
+
+    if (npos < 1) {
         if (rank == 0) {
-            printf("Usage: mpirun -np <procs> %s <data_directory> [max_cities] [comm_mode] [dist_mode]\n", argv[0]);
-            printf("  comm_mode: blocking, nonblocking (default: blocking)\n");
-            printf("  dist_mode: block, cyclic (default: block)\n");
+            printf("Usage: mpirun -np <procs> %s <data_directory> [max_cities] [comm_mode] [dist_mode] [threads_per_rank] [options]\n", argv[0]);
+            printf("  comm_mode: blocking, nonblocking, reduce, hierarchical (default: blocking)\n");
+            printf("  dist_mode: block, cyclic, balanced, dynamic, mpiio (default: block)\n");
+            printf("             mpiio: <data_directory> is one concatenated CSV file read with MPI-IO\n");
+            printf("  threads_per_rank: OpenMP threads per rank, hybrid build only (default: OMP_NUM_THREADS)\n");
+            printf("Options:\n");
+            printf("  --wire <format>  result gather format: struct, packed, packed-f32 (default: struct)\n");
+            printf("  --checkpoint <dir>  append finished cities to per-rank, per-thread logs in <dir>\n");
+            printf("  --checkpoint-interval <sec>  seconds between appends (default: %.0f)\n", CKPT_DEFAULT_INTERVAL);
+            printf("  --resume         skip files already recorded in the checkpoint (not with mpiio)\n");
+            printf("  --days <metric>  rank individual days: hottest, coldest, wettest (not with mpiio)\n");
+            printf("  --days-n <N>     days listed by --days (default: %d)\n", DAYS_DEFAULT_N);
+            printf("  --days-sort <prefix>  also sort every day globally (sample sort), one\n");
+            printf("                   <prefix>.<rank>.csv per rank, concatenated in rank order\n");
+            printf("  --counters       hardware counters (cycles, IPC, cache/branch/TLB misses) per phase,\n");
+            printf("                   rank and thread (not with mpiio)\n");
+            bench_usage();
+            printf("                   (--bench: not with mpiio, --checkpoint or --days)\n");
             printf("Example: mpirun -np 4 %s ../data/cities 100 blocking block\n", argv[0]);
         }
         MPI_Finalize();
         return 1;
     }
 
-    const char* data_dir = argv[1];
-    int max_cities = MAX_CITIES;
+    const char* data_dir = pos[0];
+    int max_cities = MAX_CITIES_ALL;
     const char* comm_mode = "blocking";
     const char* dist_mode = "block";
 
-    if (argc >= 3) max_cities = atoi(argv[2]);
-    if (argc >= 4) comm_mode = argv[3];
-    if (argc >= 5) dist_mode = argv[4];
+    if (npos >= 2) max_cities = parse_max_cities(pos[1]);
+    if (npos >= 3) comm_mode = pos[2];
+    if (npos >= 4) dist_mode = pos[3];
+
+    // Repeated runs must not append checkpoints or re-rank days
+    if (bench.reps > 0 && (ckpt_dir || days_query || strcmp(dist_mode, "mpiio") == 0)) {
+        if (rank == 0) fprintf(stderr, "--bench cannot be combined with mpiio, --checkpoint or --days\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    int threads_per_rank = 1;
+#ifdef _OPENMP
+    threads_per_rank = omp_get_max_threads();
+    if (npos >= 5) threads_per_rank = atoi(pos[4]);
+    if (threads_per_rank < 1) threads_per_rank = 1;
+    omp_set_num_threads(threads_per_rank);
+#endif
+
+    // Phase timers and --counters groups for this rank's threads; the main
+    // thread times and counts from the directory scan on
+    PerfCounters* perf = NULL;
+    if (counters && strcmp(dist_mode, "mpiio") == 0) {
+        if (rank == 0) printf("Note: --counters is not supported with mpiio and is ignored\n");
+    } else if (counters) {
+        perf = malloc(threads_per_rank * sizeof(PerfCounters));
+        if (!perf) {
+            fprintf(stderr, "Rank %d: malloc failed for counters\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (int t = 0; t < threads_per_rank; t++) perf_init(&perf[t]);
+        perf_open(&perf[0]);
+        perf_counters = perf;
+    }
+    PhaseTimer* timers = malloc(threads_per_rank * sizeof(PhaseTimer));
+    if (!timers) {
+        fprintf(stderr, "Rank %d: malloc failed for phase timers\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int t = 0; t < threads_per_rank; t++) phase_timer_init(&timers[t], perf ? &perf[t] : NULL);
+    phase_timers = timers;
+
+    double startup_start = phase_clock();
+    phase_switch(&timers[0], PHASE_ENUMERATE);
 
     if (rank == 0) {
+#ifdef _OPENMP
+        printf("Weather Analysis - Hybrid MPI+OpenMP Version\n");
+#else
         printf("Weather Analysis - MPI Distributed Version\n");
+#endif
         printf("Data directory: %s\n", data_dir);
-        printf("Max cities: %d\n", max_cities);
+        if (max_cities == MAX_CITIES_ALL) printf("Max cities: all\n");
+        else printf("Max cities: %d\n", max_cities);
         printf("Processes: %d\n", size);
+        printf("Threads per process: %d\n", threads_per_rank);
         printf("Communication: %s\n", comm_mode);
         printf("Distribution: %s\n", dist_mode);
+        printf("Wire format: %s\n", wire_name);
     }
 
-    // All processes collect file list (simpler than broadcasting)
-    collect_files(data_dir, max_cities);
+    if (strcmp(dist_mode, "mpiio") == 0) {
+        int rc = run_mpiio(data_dir, rank, size, startup_start);
+        free(timers);
+        MPI_Finalize();
+        return rc;
+    }
 
+    // Rank 0 lists the directory once; everyone else gets the manifest
+    CityStats* restored = NULL;
+    int restored_count = 0;
+    file_list_init(&file_list);
     if (rank == 0) {
-        printf("Files found: %d\n", num_files);
+        file_list_scan(&file_list, data_dir, max_cities, 1);
+        if (ckpt_dir) {
+            mkdir(ckpt_dir, 0755);
+            if (resume) {
+                restored_count = resume_from_checkpoint(ckpt_dir, &restored);
+                printf("Resumed from checkpoint: %d cities restored, %d files left\n",
+                       restored_count, file_list.count);
+            } else {
+                ckpt_clear(ckpt_dir);
+            }
+        }
     }
+    long manifest_bytes = broadcast_manifest(data_dir, rank);
+    double startup_time = phase_clock() - startup_start;
+    phase_switch(&timers[0], PHASE_NONE);
 
-    MPI_Barrier(MPI_COMM_WORLD);
-    double start_time = MPI_Wtime();
+    if (rank == 0) {
+        printf("Files found: %d\n", file_list.count);
+        printf("Manifest size: %ld bytes\n", manifest_bytes);
+    }
 
-    // Determine which files this process handles based on distribution mode
-    int my_count = 0;
-    int* my_file_indices = malloc(num_files * sizeof(int));  // Max possible
+    // Run-lifetime allocations (file indices, results, gather arrays) come
+    // from one arena per rank; per-file scratch from one arena per thread
+    Arena run_arena;
+    size_t run_bytes = (size_t)file_list.count * (2 * sizeof(CityStats) + 2 * sizeof(int))
+                     + (size_t)size * (2 * sizeof(int) + sizeof(long long))
+                     + (size_t)(file_list.count / STREAM_BATCH + size) * (sizeof(MPI_Request) + 3 * sizeof(int))
+                     + 32 * ARENA_ALIGN;
+    // Packed wire: this rank's send buffer, rank 0's receive buffer and the
+    // decoded results array
+    if (wire != WIRE_STRUCT) {
+        run_bytes += (size_t)file_list.count * (2 * PACKED_CITY_MAX + sizeof(CityStats)) + 4 * ARENA_ALIGN;
+    }
+    // Reduce: per-city pick flags, this rank's candidates and rank 0's gather
+    if (strcmp(comm_mode, "reduce") == 0) {
+        run_bytes += (size_t)file_list.count + (size_t)(size + 1) * 3 * TOP_K * sizeof(CityStats)
+                   + 4 * ARENA_ALIGN;
+    }
+    Arena* worker_arenas = malloc(threads_per_rank * sizeof(Arena));
+    if (!worker_arenas || arena_init(&run_arena, run_bytes) != 0) {
+        fprintf(stderr, "Rank %d: failed to reserve arenas\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int t = 0; t < threads_per_rank; t++) {
+        if (arena_init(&worker_arenas[t], SCRATCH_ARENA_SIZE) != 0) {
+            fprintf(stderr, "Rank %d: failed to reserve scratch arena\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
 
-    if (strcmp(dist_mode, "cyclic") == 0) {
-        // Cyclic distribution: rank 0 gets files 0, size, 2*size, ...
-        //                      rank 1 gets files 1, size+1, 2*size+1, ...
-        for (int i = rank; i < num_files; i += size) {
-            my_file_indices[my_count++] = i;
+    // Checkpointing: one append-only log per thread of every rank. Rank 0
+    // cleared or read the directory before the manifest went out.
+    CheckpointLog* logs = NULL;
+    if (ckpt_dir) {
+        logs = calloc(threads_per_rank, sizeof(CheckpointLog));
+        if (!logs) {
+            fprintf(stderr, "Rank %d: malloc failed for checkpoint logs\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, 1);
         }
-    } else {
-        // Block distribution (default): contiguous chunks
-        int files_per_proc = (num_files + size - 1) / size;
-        int my_start = rank * files_per_proc;
-        int my_end = my_start + files_per_proc;
-        if (my_end > num_files) my_end = num_files;
-        for (int i = my_start; i < my_end && i < num_files; i++) {
-            my_file_indices[my_count++] = i;
-        }
-    }
-
-    // Process local files
-    CityStats* local_results = NULL;
-    if (my_count > 0) {
-        local_results = malloc(my_count * sizeof(CityStats));
-        if (!local_results) {
-            fprintf(stderr, "Rank %d: malloc failed\n", rank);
+        for (int t = 0; t < threads_per_rank; t++) {
+            char worker[64];
+            snprintf(worker, sizeof(worker), "rank%d.thread%d", rank, t);
+            if (ckpt_open(&logs[t], ckpt_dir, worker, sizeof(CityStats), ckpt_interval) != 0) {
+                fprintf(stderr, "Rank %d: failed to open checkpoint log in %s\n", rank, ckpt_dir);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        }
+        ckpt_logs = logs;
+    }
+
+    // Daily-record ranking: one sink per thread, a bounded heap of the best
+    // days_n for selection, or every record for the global sort
+    DaySink* sinks = NULL;
+    if (days_query) {
+        if (days_n < 1) days_n = DAYS_DEFAULT_N;
+        sinks = malloc(threads_per_rank * sizeof(DaySink));
+        if (!sinks) {
+            fprintf(stderr, "Rank %d: malloc failed for day sinks\n", rank);
             MPI_Abort(MPI_COMM_WORLD, 1);
         }
+        for (int t = 0; t < threads_per_rank; t++) {
+            day_sink_init(&sinks[t], days_sort ? 0 : days_n, days_metric);
+        }
+        day_sinks = sinks;
+        if (rank == 0 && restored_count > 0) {
+            printf("Note: days of the %d restored cities are not ranked\n", restored_count);
+        }
     }
 
-    for (int i = 0; i < my_count; i++) {
-        int file_idx = my_file_indices[i];
-        strncpy(local_results[i].name, city_names[file_idx], MAX_NAME);
-        process_city_file(file_paths[file_idx], &local_results[i]);
+    // Results of the last run (the only run unless --bench)
+    int my_count = 0;
+    int streaming = 0;
+    double process_time = 0;   // distribution through the last file of this rank
+    MPI_Datatype city_type = MPI_DATATYPE_NULL;
+    CityStats* all_results = NULL;
+    int total_cities = 0;   // CityStats held by rank 0 (all cities, or candidates)
+    GlobalTotals totals;
+    long gather_bytes = 0;  // result payload received by rank 0
+    double gather_time = 0;
+    StreamStats stream;
+    int nodes = 0;          // hierarchical mode: node leaders sending to rank 0
+    long local_records = 0;
+    int counter_fetches = 0;
+    double ckpt_time = 0;
+    long ckpt_records = 0;
+    double process_cpu = 0;
+    long long my_bytes = 0;
+    CityStats* combined = NULL;
+    double elapsed = 0;
+
+    int runs = bench_start(&bench);
+    if (runs == 0) {
+        fprintf(stderr, "Rank %d: malloc failed for benchmark times\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    free(my_file_indices);
+    // Each run starts from the same run arena state
+    size_t run_mark = arena_mark(&run_arena);
+    for (int run = 0; run < runs; run++) {
+        arena_reset_to(&run_arena, run_mark);
+        for (int t = 0; t < threads_per_rank; t++) phase_restart(&timers[t]);
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start_time = phase_clock();
+
+        // Determine which files this process handles based on distribution mode
+        my_count = 0;
+        int* my_file_indices = arena_alloc(&run_arena, file_list.count * sizeof(int));  // Max possible
+
+        if (strcmp(dist_mode, "cyclic") == 0) {
+            // Cyclic distribution: rank 0 gets files 0, size, 2*size, ...
+            //                      rank 1 gets files 1, size+1, 2*size+1, ...
+            for (int i = rank; i < file_list.count; i += size) {
+                my_file_indices[my_count++] = i;
+            }
+        } else if (strcmp(dist_mode, "balanced") == 0) {
+            // Balanced distribution: equal bytes per rank from the manifest sizes
+            my_count = assign_balanced(rank, size, my_file_indices, &run_arena);
+        } else if (strcmp(dist_mode, "dynamic") == 0) {
+            // Dynamic distribution: files are claimed batch by batch while processing
+        } else {
+            // Block distribution (default): contiguous chunks
+            int files_per_proc = (file_list.count + size - 1) / size;
+            int my_start = rank * files_per_proc;
+            int my_end = my_start + files_per_proc;
+            if (my_end > file_list.count) my_end = file_list.count;
+            for (int i = my_start; i < my_end && i < file_list.count; i++) {
+                my_file_indices[my_count++] = i;
+            }
+        }
 
-    // Gather results to rank 0
-    // First gather counts
-    int* all_counts = NULL;
-    int* displacements = NULL;
-    if (rank == 0) {
-        all_counts = malloc(size * sizeof(int));
-        displacements = malloc(size * sizeof(int));
-        if (!all_counts || !displacements) {
-            fprintf(stderr, "Rank 0: malloc failed for gather arrays\n");
-            MPI_Abort(MPI_COMM_WORLD, 1);
+        // Nonblocking mode streams results to rank 0 while processing; with the
+        // dynamic distribution file counts are only known at the end, so it
+        // falls back to a single nonblocking gather
+        streaming = strcmp(comm_mode, "nonblocking") == 0 && wire == WIRE_STRUCT &&
+                        strcmp(dist_mode, "dynamic") != 0;
+
+        double assign_time = phase_clock() - start_time;
+        phase_switch(&timers[0], PHASE_REDUCE);
+        if (run > 0) MPI_Type_free(&city_type);
+        city_type = create_city_type();
+        phase_switch(&timers[0], PHASE_NONE);
+
+        all_results = NULL;
+        total_cities = 0;
+        gather_bytes = 0;
+        gather_time = 0;
+        nodes = 0;
+
+        // Process local files
+        CityStats* local_results = NULL;
+        local_records = 0;
+        counter_fetches = 0;
+
+        double process_start = phase_clock();
+        double cpu_start = cpu_time_sec();
+        if (streaming) {
+            local_records = stream_results(my_file_indices, my_count, worker_arenas, city_type, rank, size,
+                                           &run_arena, &all_results, &total_cities, &totals, &stream);
+        } else if (strcmp(dist_mode, "dynamic") == 0) {
+            // Which files this rank wins is only known as it goes: room for all
+            if (file_list.count > 0) {
+                local_results = arena_alloc(&run_arena, file_list.count * sizeof(CityStats));
+                if (!local_results) {
+                    fprintf(stderr, "Rank %d: arena exhausted\n", rank);
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+            }
+            my_count = process_dynamic(size, threads_per_rank, my_file_indices, local_results,
+                                       worker_arenas, &local_records, &counter_fetches);
+        } else {
+            if (my_count > 0) {
+                local_results = arena_alloc(&run_arena, my_count * sizeof(CityStats));
+                if (!local_results) {
+                    fprintf(stderr, "Rank %d: arena exhausted\n", rank);
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+            }
+            local_records = process_file_list(my_file_indices, my_count, local_results, worker_arenas);
+        }
+
+        // Final append so a finished run leaves a complete checkpoint
+        phase_switch(&timers[0], PHASE_IO);
+        ckpt_time = 0;
+        ckpt_records = 0;
+        for (int t = 0; logs && t < threads_per_rank; t++) {
+            ckpt_close(&logs[t]);
+            if (logs[t].time > ckpt_time) ckpt_time = logs[t].time;
+            ckpt_records += logs[t].records;
+        }
+        ckpt_logs = NULL;
+        phase_switch(&timers[0], PHASE_NONE);
+        process_time = assign_time + phase_clock() - process_start;
+        process_cpu = cpu_time_sec() - cpu_start;
+
+        my_bytes = 0;
+        for (int i = 0; i < my_count; i++) {
+            my_bytes += file_list.sizes[my_file_indices[i]];
         }
-    }
 
-    MPI_Gather(&my_count, 1, MPI_INT, all_counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        phase_switch(&timers[0], PHASE_REDUCE);
+        if (streaming) {
+            gather_bytes = stream.bytes;
+            gather_time = stream.drain_time;
+        } else if (strcmp(comm_mode, "hierarchical") == 0) {
+            double t0 = phase_clock();
+            total_cities = gather_hierarchical(local_results, my_count, city_type, rank, &run_arena,
+                                               &all_results, &totals, &nodes, &gather_bytes);
+            gather_time = phase_clock() - t0;
+        } else if (strcmp(comm_mode, "reduce") == 0) {
+            total_cities = reduce_results(local_results, my_count, city_type, rank, size,
+                                          &run_arena, &all_results, &totals);
+        } else if (wire != WIRE_STRUCT) {
+            double t0 = phase_clock();
+            total_cities = gather_packed(local_results, my_file_indices, my_count, wire == WIRE_PACKED_F32,
+                                         strcmp(comm_mode, "nonblocking") == 0, rank, size,
+                                         &run_arena, &all_results, &gather_bytes);
+            gather_time = phase_clock() - t0;
+
+            if (rank == 0) compute_totals(all_results, total_cities, &totals);
+        } else {
+            double t0 = phase_clock();
+
+            // Gather results to rank 0
+            // First gather counts
+            int* all_counts = NULL;
+            int* displacements = NULL;
+            if (rank == 0) {
+                all_counts = arena_alloc(&run_arena, size * sizeof(int));
+                displacements = arena_alloc(&run_arena, size * sizeof(int));
+                if (!all_counts || !displacements) {
+                    fprintf(stderr, "Rank 0: arena exhausted for gather arrays\n");
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+            }
 
-    // Create MPI datatype for CityStats (now includes monthly arrays)
-    MPI_Datatype city_type;
-    int blocklengths[] = {MAX_NAME, 1, 1, 1, 1, 1, 1, 1, 12, 12};
-    MPI_Aint offsets[10];
-    offsets[0] = offsetof(CityStats, name);
-    offsets[1] = offsetof(CityStats, temp_sum);
-    offsets[2] = offsetof(CityStats, temp_min);
-    offsets[3] = offsetof(CityStats, temp_max);
-    offsets[4] = offsetof(CityStats, precip_sum);
-    offsets[5] = offsetof(CityStats, temp_count);
-    offsets[6] = offsetof(CityStats, precip_count);
-    offsets[7] = offsetof(CityStats, record_count);
-    offsets[8] = offsetof(CityStats, monthly_temp_sum);
-    offsets[9] = offsetof(CityStats, monthly_temp_count);
-    MPI_Datatype types[] = {MPI_CHAR, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE,
-                            MPI_INT, MPI_INT, MPI_INT, MPI_DOUBLE, MPI_INT};
+            MPI_Gather(&my_count, 1, MPI_INT, all_counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+            if (rank == 0) {
+                for (int i = 0; i < size; i++) {
+                    total_cities += all_counts[i];
+                }
+                all_results = arena_alloc(&run_arena, total_cities * sizeof(CityStats));
+                if (!all_results && total_cities > 0) {
+                    fprintf(stderr, "Rank 0: arena exhausted for all_results\n");
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+
+                displacements[0] = 0;
+                for (int i = 1; i < size; i++) {
+                    displacements[i] = displacements[i-1] + all_counts[i-1];
+                }
+            }
 
-    MPI_Type_create_struct(10, blocklengths, offsets, types, &city_type);
-    MPI_Type_commit(&city_type);
+            if (strcmp(comm_mode, "nonblocking") == 0) {
+                // Non-blocking gather
+                MPI_Request request;
+                MPI_Igatherv(local_results, my_count, city_type,
+                             all_results, all_counts, displacements, city_type,
+                             0, MPI_COMM_WORLD, &request);
+                MPI_Wait(&request, MPI_STATUS_IGNORE);
+            } else {
+                // Blocking gather
+                MPI_Gatherv(local_results, my_count, city_type,
+                            all_results, all_counts, displacements, city_type,
+                            0, MPI_COMM_WORLD);
+            }
 
-    CityStats* all_results = NULL;
-    int total_cities = 0;
+            int type_size;
+            MPI_Type_size(city_type, &type_size);
+            gather_bytes = (long)total_cities * type_size;
+            gather_time = phase_clock() - t0;
 
-    if (rank == 0) {
-        for (int i = 0; i < size; i++) {
-            total_cities += all_counts[i];
+            if (rank == 0) compute_totals(all_results, total_cities, &totals);
         }
-        all_results = malloc(total_cities * sizeof(CityStats));
-        if (!all_results) {
-            fprintf(stderr, "Rank 0: malloc failed for all_results\n");
-            MPI_Abort(MPI_COMM_WORLD, 1);
+
+        // Results restored from the checkpoint join the collected ones on rank 0
+        combined = NULL;
+        if (rank == 0 && restored_count > 0) {
+            combined = malloc((size_t)(total_cities + restored_count) * sizeof(CityStats));
+            if (!combined) {
+                fprintf(stderr, "Rank 0: malloc failed for combined results\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            if (total_cities > 0) memcpy(combined, all_results, total_cities * sizeof(CityStats));
+            memcpy(combined + total_cities, restored, restored_count * sizeof(CityStats));
+            fold_totals(&totals, restored, restored_count);
+            all_results = combined;
+            total_cities += restored_count;
         }
 
-        displacements[0] = 0;
-        for (int i = 1; i < size; i++) {
-            displacements[i] = displacements[i-1] + all_counts[i-1];
+        elapsed = phase_clock() - start_time;
+        phase_switch(&timers[0], PHASE_NONE);
+        // --bench: a run lasts as long as its slowest rank
+        if (bench.reps > 0) {
+            double run_max;
+            MPI_Reduce(&elapsed, &run_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+            if (rank == 0) bench_record(&bench, run, run_max);
         }
     }
 
-    if (strcmp(comm_mode, "nonblocking") == 0) {
-        // Non-blocking gather
-        MPI_Request request;
-        MPI_Igatherv(local_results, my_count, city_type,
-                     all_results, all_counts, displacements, city_type,
-                     0, MPI_COMM_WORLD, &request);
-        MPI_Wait(&request, MPI_STATUS_IGNORE);
-    } else {
-        // Blocking gather
-        MPI_Gatherv(local_results, my_count, city_type,
-                    all_results, all_counts, displacements, city_type,
-                    0, MPI_COMM_WORLD);
-    }
+    // Daily-record query: fold thread sinks, optionally sample-sort, then
+    // select the top N on rank 0
+    DaySink top;
+    int day_candidates = 0;
+    long day_seen = 0, day_sent = 0, day_bucket_min = 0, day_bucket_max = 0;
+    double days_time = 0;
+    int days_written = 0;
+    if (sinks) {
+        double t0 = phase_clock();
+        phase_switch(&timers[0], PHASE_REDUCE);
+        day_sinks = NULL;
+        for (int t = 1; t < threads_per_rank; t++) {
+            if (day_sink_merge(&sinks[0], &sinks[t]) != 0) {
+                fprintf(stderr, "Rank %d: malloc failed merging day sinks\n", rank);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            day_sink_free(&sinks[t]);
+        }
+        MPI_Datatype day_type;
+        MPI_Type_contiguous(sizeof(DayRecord), MPI_BYTE, &day_type);
+        MPI_Type_commit(&day_type);
+
+        MPI_Reduce(&sinks[0].seen, &day_seen, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (days_sort) {
+            long sent = sample_sort_days(&sinks[0], day_type, rank, size);
+            long offset = 0;
+            MPI_Exscan(&sinks[0].count, &offset, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+            if (rank == 0) offset = 0;
+            int ok = write_sorted_days(days_sort, &sinks[0], offset, rank) == 0;
+            MPI_Reduce(&ok, &days_written, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+            MPI_Reduce(&sent, &day_sent, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+            MPI_Reduce(&sinks[0].count, &day_bucket_min, 1, MPI_LONG, MPI_MIN, 0, MPI_COMM_WORLD);
+            MPI_Reduce(&sinks[0].count, &day_bucket_max, 1, MPI_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+        } else {
+            day_sink_sort(&sinks[0]);
+        }
 
-    double end_time = MPI_Wtime();
-    double elapsed = end_time - start_time;
+        if (rank == 0) day_sink_init(&top, days_n, days_metric);
+        day_candidates = gather_top_days(sinks[0].recs, sinks[0].count, days_n, day_type, rank, size, &top);
+        day_sink_free(&sinks[0]);
+        free(sinks);
+        MPI_Type_free(&day_type);
+        days_time = phase_clock() - t0;
+        phase_switch(&timers[0], PHASE_NONE);
+    }
 
     // Get max time across all processes
     double max_elapsed;
     MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
+    long total_records = 0;
+    MPI_Reduce(&local_records, &total_records, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    double max_startup;
+    MPI_Reduce(&startup_time, &max_startup, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
     if (rank == 0) {
-        print_results(all_results, total_cities);
+        phase_switch(&timers[0], PHASE_REPORT);
+        print_rankings(all_results, total_cities);
+        print_overall(&totals);
+        if (days_query) {
+            print_day_ranking(&top, days_n);
+            printf("Daily records ranked: %ld (%d candidates gathered to rank 0) in %.3f seconds\n",
+                   day_seen, day_candidates, days_time);
+            if (days_sort) {
+                printf("Global sort: %d of %d rank files written to %s.<rank>.csv, %ld records exchanged, bucket min/max %ld/%ld\n",
+                       days_written, size, days_sort, day_sent, day_bucket_min, day_bucket_max);
+            }
+            day_sink_free(&top);
+        }
 
         printf("\n========== PERFORMANCE ==========\n");
+        printf("Startup time (enumerate + manifest broadcast): %.3f seconds\n", max_startup);
         printf("Processing time: %.3f seconds\n", max_elapsed);
-        printf("Cities processed: %d\n", total_cities);
+        printf("Cities processed: %ld\n", totals.cities);
+        if (strcmp(comm_mode, "reduce") == 0) {
+            printf("Ranking candidates gathered: %d\n", total_cities);
+        } else if (strcmp(comm_mode, "hierarchical") == 0) {
+            printf("Node groups: %d (rank 0 fan-in %d messages instead of %d)\n", nodes, nodes - 1, size - 1);
+            printf("Inter-node gather: %ld bytes in %.4f seconds\n", gather_bytes, gather_time);
+        } else if (streaming) {
+            printf("Streamed batches: %d of up to %d cities (%d arrived during rank 0 compute)\n",
+                   stream.batches, STREAM_BATCH, stream.hidden);
+            printf("Communication hidden: %.1f%% of %ld bytes; exposed drain wait %.4f s, max sender wait %.4f s\n",
+                   stream.bytes > 0 ? 100.0 * stream.hidden_bytes / stream.bytes : 100.0,
+                   stream.bytes, stream.drain_time, stream.send_wait);
+        } else {
+            printf("Result gather (%s): %ld bytes (%.1f bytes/city) in %.4f seconds\n",
+                   wire_name, gather_bytes, total_cities > 0 ? (double)gather_bytes / total_cities : 0,
+                   gather_time);
+        }
         printf("Processes used: %d\n", size);
-        printf("Throughput: %.2f cities/second\n", total_cities / max_elapsed);
+        printf("Threads per process: %d\n", threads_per_rank);
+        printf("Total workers: %d\n", size * threads_per_rank);
+        printf("Throughput: %.2f cities/second\n", totals.cities / max_elapsed);
+        printf("Record throughput: %.2f records/second\n", total_records / max_elapsed);
+        print_arena_stats("Rank 0 run", &run_arena, 1);
+        print_arena_stats("Rank 0 scratch", worker_arenas, threads_per_rank);
+        printf("Rank 0 peak RSS: %.1f MB\n", peak_rss_kb() / 1024.0);
+        phase_switch(&timers[0], PHASE_NONE);
+    }
 
-        free(all_results);
-        free(all_counts);
-        free(displacements);
+    print_distribution(my_count, my_bytes, process_time, rank, size);
+    print_phase_report(timers, process_time, process_cpu, threads_per_rank, rank, size);
+    phase_timers = NULL;
+    free(timers);
+    if (perf) {
+        perf_close(&perf[0]);
+        print_counters(perf, threads_per_rank, rank, size);
+        perf_counters = NULL;
+        free(perf);
     }
 
-    if (local_results) free(local_results);
+    if (logs) {
+        double max_ckpt;
+        long total_ckpt;
+        MPI_Reduce(&ckpt_time, &max_ckpt, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&ckpt_records, &total_ckpt, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            print_checkpoint_stats("Rank 0", logs, threads_per_rank, elapsed);
+            printf("Checkpointed cities (all ranks): %ld; slowest worker checkpoint time %.4f s (%.2f%% of run)\n",
+                   total_ckpt, max_ckpt, max_elapsed > 0 ? 100.0 * max_ckpt / max_elapsed : 0);
+        }
+        free(logs);
+    }
+    free(combined);
+    free(restored);
+
+    if (strcmp(dist_mode, "dynamic") == 0) {
+        int total_fetches = 0;
+        MPI_Reduce(&counter_fetches, &total_fetches, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) printf("Work counter fetches: %d\n", total_fetches);
+    }
+
+    int rc = 0;
+    if (bench.reps > 0) {
+        double process_max, process_sum;
+        MPI_Reduce(&process_time, &process_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&process_time, &process_sum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            char bench_config[128];
+            snprintf(bench_config, sizeof(bench_config), "procs=%d threads=%d comm=%s dist=%s wire=%s",
+                     size, threads_per_rank, comm_mode, dist_mode, wire_name);
+#ifdef _OPENMP
+            const char* backend = "hybrid";
+#else
+            const char* backend = "mpi";
+#endif
+            double imbalance = process_sum > 0 ? process_max * size / process_sum : 1.0;
+            rc = bench_report(&bench, backend, bench_config, size * threads_per_rank, imbalance,
+                              data_dir, totals.cities) == 0 ? 0 : 1;
+        }
+    }
+    bench_free(&bench);
+
+    for (int t = 0; t < threads_per_rank; t++) arena_free(&worker_arenas[t]);
+    free(worker_arenas);
+    arena_free(&run_arena);
+    file_list_free(&file_list);
     MPI_Type_free(&city_type);
     MPI_Finalize();
 
-    return 0;
+    return rc;
 }
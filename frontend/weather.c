@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Unified front end: one binary, backend chosen at run time
+ *
+ *   weather --backend serial|omp|mpi --data <dir> [--max-cities N]
+ *           [--threads N] [--schedule S] [--chunk N] [--dist M] [--comm M]
+ *           [backend options]
+ *
+ * Every backend is compiled into this binary as its own translation unit
+ * (built with -DWEATHER_FRONTEND, which renames its main), so each keeps
+ * its specialised hot loop. The front end validates the named options
+ * against the selected backend, translates them into that backend's
+ * positional convention and calls its entry point. MPI runs are launched
+ * as usual: mpirun -np 4 ./frontend/weather --backend mpi ...
+ */
+
+#define DEFAULT_MAX_CITIES "all"
+
+int weather_serial_main(int argc, char* argv[]);
+int weather_omp_main(int argc, char* argv[]);
+int weather_mpi_main(int argc, char* argv[]);
+
+enum { BACKEND_SERIAL = 1, BACKEND_OMP = 2, BACKEND_MPI = 4 };
+
+// Options forwarded unchanged, with the backends that accept them
+typedef struct {
+    const char* name;
+    int has_value;
+    int backends;
+} PassOption;
+
+static const PassOption pass_options[] = {
+    {"--checkpoint", 1, BACKEND_OMP | BACKEND_MPI},
+    {"--checkpoint-interval", 1, BACKEND_OMP | BACKEND_MPI},
+    {"--resume", 0, BACKEND_OMP | BACKEND_MPI},
+    {"--days", 1, BACKEND_OMP | BACKEND_MPI},
+    {"--days-n", 1, BACKEND_OMP | BACKEND_MPI},
+    {"--days-sort", 1, BACKEND_MPI},
+    {"--wire", 1, BACKEND_MPI},
+    {"--autotune", 0, BACKEND_OMP},
+    {"--tune-budget", 1, BACKEND_OMP},
+    {"--tune-file", 1, BACKEND_OMP},
+    {"--bench", 1, BACKEND_SERIAL | BACKEND_OMP | BACKEND_MPI},
+    {"--bench-warmup", 1, BACKEND_SERIAL | BACKEND_OMP | BACKEND_MPI},
+    {"--bench-out", 1, BACKEND_SERIAL | BACKEND_OMP | BACKEND_MPI},
+    {"--bench-baseline", 1, BACKEND_SERIAL | BACKEND_OMP | BACKEND_MPI},
+    {"--counters", 0, BACKEND_SERIAL | BACKEND_OMP | BACKEND_MPI},
+};
+#define NUM_PASS_OPTIONS ((int)(sizeof(pass_options) / sizeof(pass_options[0])))
+
+static const char* backend_name(int backend) {
+    switch (backend) {
+        case BACKEND_SERIAL: return "serial";
+        case BACKEND_OMP: return "omp";
+        default: return "mpi";
+    }
+}
+
+// Only rank 0 of an MPI launch prints front-end messages
+static int is_primary_process(void) {
+    const char* vars[] = {"OMPI_COMM_WORLD_RANK", "PMI_RANK", "PMIX_RANK"};
+    for (int i = 0; i < 3; i++) {
+        const char* v = getenv(vars[i]);
+        if (v) return atoi(v) == 0;
+    }
+    return 1;
+}
+
+// Instruction-set extensions the build targets and the host supports
+static void print_cpu_features(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    printf("CPU features compiled in:");
+#ifdef __SSE2__
+    printf(" sse2");
+#endif
+#ifdef __SSE4_2__
+    printf(" sse4.2");
+#endif
+#ifdef __AVX__
+    printf(" avx");
+#endif
+#ifdef __AVX2__
+    printf(" avx2");
+#endif
+#ifdef __FMA__
+    printf(" fma");
+#endif
+#ifdef __AVX512F__
+    printf(" avx512f");
+#endif
+    printf("\n");
+
+    __builtin_cpu_init();
+    printf("CPU features available:");
+    if (__builtin_cpu_supports("sse2")) printf(" sse2");
+    if (__builtin_cpu_supports("sse4.2")) printf(" sse4.2");
+    if (__builtin_cpu_supports("avx")) printf(" avx");
+    if (__builtin_cpu_supports("avx2")) printf(" avx2");
+    if (__builtin_cpu_supports("fma")) printf(" fma");
+    if (__builtin_cpu_supports("avx512f")) printf(" avx512f");
+    printf("\n");
+#else
+    printf("CPU features: generic build (no x86 extensions)\n");
+#endif
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s --backend serial|omp|mpi --data <data_directory> [options]\n", prog);
+    printf("  --backend <name>     serial, omp or mpi (mpi: launch with mpirun)\n");
+    printf("  --data <path>        data directory (mpi --dist mpiio: one concatenated CSV)\n");
+    printf("  --max-cities <N>     files to process, or all (default: %s)\n", DEFAULT_MAX_CITIES);
+    printf("  --threads <N>        omp: threads; mpi: OpenMP threads per rank\n");
+    printf("  --schedule <kind>    omp: static, dynamic, guided (default: dynamic)\n");
+    printf("  --chunk <N>          omp: iterations per chunk (default: 1)\n");
+    printf("  --dist <mode>        mpi: block, cyclic, balanced, dynamic, mpiio (default: block)\n");
+    printf("  --comm <mode>        mpi: blocking, nonblocking, reduce, hierarchical (default: blocking)\n");
+    printf("Backend options, forwarded unchanged:\n");
+    for (int i = 0; i < NUM_PASS_OPTIONS; i++) {
+        printf("  %-22s", pass_options[i].name);
+        for (int b = BACKEND_SERIAL; b <= BACKEND_MPI; b <<= 1) {
+            if (pass_options[i].backends & b) printf(" %s", backend_name(b));
+        }
+        printf("\n");
+    }
+    printf("Example: %s --backend omp --data data/cities --threads 8 --schedule dynamic\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    int backend = 0;
+    const char* data_dir = NULL;
+    const char* max_cities = NULL;
+    const char* threads = NULL;
+    const char* schedule = NULL;
+    const char* chunk = NULL;
+    const char* dist = NULL;
+    const char* comm = NULL;
+
+    // Forwarded options keep their order after the positional arguments
+    char** pass = malloc((argc + 1) * sizeof(char*));
+    char** args = malloc((argc + 8) * sizeof(char*));
+    if (!pass || !args) {
+        fprintf(stderr, "malloc failed for argument lists\n");
+        return 1;
+    }
+    int npass = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        int has_next = i + 1 < argc;
+        if (strcmp(a, "--help") == 0 || strcmp(a, "-h") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else if (strcmp(a, "--backend") == 0 && has_next) {
+            const char* b = argv[++i];
+            if (strcmp(b, "serial") == 0) backend = BACKEND_SERIAL;
+            else if (strcmp(b, "omp") == 0) backend = BACKEND_OMP;
+            else if (strcmp(b, "mpi") == 0) backend = BACKEND_MPI;
+            else {
+                fprintf(stderr, "Unknown backend: %s\n", b);
+                return 1;
+            }
+        } else if (strcmp(a, "--data") == 0 && has_next) {
+            data_dir = argv[++i];
+        } else if (strcmp(a, "--max-cities") == 0 && has_next) {
+            max_cities = argv[++i];
+        } else if (strcmp(a, "--threads") == 0 && has_next) {
+            threads = argv[++i];
+        } else if (strcmp(a, "--schedule") == 0 && has_next) {
+            schedule = argv[++i];
+        } else if (strcmp(a, "--chunk") == 0 && has_next) {
+            chunk = argv[++i];
+        } else if (strcmp(a, "--dist") == 0 && has_next) {
+            dist = argv[++i];
+        } else if (strcmp(a, "--comm") == 0 && has_next) {
+            comm = argv[++i];
+        } else if (strncmp(a, "--", 2) != 0 && !data_dir) {
+            data_dir = a;
+        } else {
+            int k = 0;
+            while (k < NUM_PASS_OPTIONS && strcmp(a, pass_options[k].name) != 0) k++;
+            if (k == NUM_PASS_OPTIONS || (pass_options[k].has_value && !has_next)) {
+                fprintf(stderr, "Unknown or incomplete option: %s\n", a);
+                usage(argv[0]);
+                return 1;
+            }
+            pass[npass++] = argv[i];
+            if (pass_options[k].has_value) pass[npass++] = argv[++i];
+        }
+    }
+
+    if (!backend || !data_dir) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Forwarded options must be understood by the selected backend
+    for (int i = 0; i < npass; i++) {
+        for (int k = 0; k < NUM_PASS_OPTIONS; k++) {
+            if (strcmp(pass[i], pass_options[k].name) != 0) continue;
+            if (!(pass_options[k].backends & backend)) {
+                fprintf(stderr, "Option %s is not supported by the %s backend\n", pass[i], backend_name(backend));
+                return 1;
+            }
+            if (pass_options[k].has_value) i++;
+            break;
+        }
+    }
+
+    const char* misplaced = NULL;
+    if (threads && backend == BACKEND_SERIAL) misplaced = "--threads";
+    else if (schedule && backend != BACKEND_OMP) misplaced = "--schedule";
+    else if (chunk && backend != BACKEND_OMP) misplaced = "--chunk";
+    else if (dist && backend != BACKEND_MPI) misplaced = "--dist";
+    else if (comm && backend != BACKEND_MPI) misplaced = "--comm";
+    if (misplaced) {
+        fprintf(stderr, "Option %s is not supported by the %s backend\n", misplaced, backend_name(backend));
+        return 1;
+    }
+
+    // Named options -> the backend's positional convention
+    int nargs = 0;
+    args[nargs++] = argv[0];
+    args[nargs++] = (char*)data_dir;
+
+    char default_threads[16];
+#ifdef _OPENMP
+    snprintf(default_threads, sizeof(default_threads), "%d", omp_get_max_threads());
+#else
+    snprintf(default_threads, sizeof(default_threads), "1");
+#endif
+
+    if (backend == BACKEND_OMP) {
+        // Explicit threads/schedule/chunk disable the saved tuning, so
+        // positionals are only filled up to the last one given
+        int last = chunk ? 4 : schedule ? 3 : threads ? 2 : max_cities ? 1 : 0;
+        const char* omp_pos[4] = {max_cities ? max_cities : DEFAULT_MAX_CITIES,
+                                  threads ? threads : default_threads,
+                                  schedule ? schedule : "dynamic",
+                                  chunk ? chunk : "1"};
+        for (int p = 0; p < last; p++) args[nargs++] = (char*)omp_pos[p];
+    } else if (backend == BACKEND_MPI) {
+        int last = threads ? 4 : dist ? 3 : comm ? 2 : max_cities ? 1 : 0;
+        const char* mpi_pos[4] = {max_cities ? max_cities : DEFAULT_MAX_CITIES,
+                                  comm ? comm : "blocking",
+                                  dist ? dist : "block",
+                                  threads ? threads : default_threads};
+        for (int p = 0; p < last; p++) args[nargs++] = (char*)mpi_pos[p];
+    } else if (max_cities) {
+        args[nargs++] = (char*)max_cities;
+    }
+
+    for (int i = 0; i < npass; i++) args[nargs++] = pass[i];
+    args[nargs] = NULL;
+
+    if (is_primary_process()) {
+        printf("Backend: %s\n", backend_name(backend));
+        print_cpu_features();
+    }
+
+    int rc;
+    switch (backend) {
+        case BACKEND_SERIAL: rc = weather_serial_main(nargs, args); break;
+        case BACKEND_OMP: rc = weather_omp_main(nargs, args); break;
+        default: rc = weather_mpi_main(nargs, args); break;
+    }
+
+    free(pass);
+    free(args);
+    return rc;
+}
@@ -4,321 +4,755 @@
 #include <dirent.h>
 #include <time.h>
 #include <float.h>
-#include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <omp.h>
+#include "../common/checkpoint.h"
+#include "../common/weather_core.h"
+#include "../common/bench.h"
 
-#define MAX_CITIES 2000
-#define MAX_LINE 1024
-#define MAX_NAME 128
-#define MAX_FILES 2000
+#define SCRATCH_ARENA_SIZE (4UL * 1024 * 1024)
 
+// Auto-tuner defaults
+#define TUNE_FILE_NAME ".weather_omp_tune"
+#define TUNE_DEFAULT_BUDGET 10.0   // seconds of calibration
+#define TUNE_MAX_SAMPLE 256        // files per calibration pass
+#define TUNE_REPS 2                // timed passes per candidate (best kept)
+
+// Daily-record ranking: records listed by default
+#define DAYS_DEFAULT_N 100
+
+// Checkpoint defaults
+#define CKPT_DEFAULT_INTERVAL 30.0  // seconds between appends per thread
+
+// One point in the tuning space
+typedef struct {
+    int threads;
+    omp_sched_t schedule;
+    int chunk_size;
+    int buffer_size;   // stdio buffer per file, 0 = libc default
+} TuneConfig;
+
+// Per-thread load-balance counters, cache-line aligned so threads never
+// share a line on the hot path
 typedef struct {
-    char name[MAX_NAME];
-    double temp_sum;
-    double temp_min;
-    double temp_max;
-    double precip_sum;
-    int temp_count;
-    int precip_count;
-    int record_count;
-    double monthly_temp_sum[12];
-    int monthly_temp_count[12];
-} CityStats;
-
-// Thread-local storage for city stats
-static CityStats cities[MAX_CITIES];
+    double busy_time;      // seconds inside process_city_file_phased
+    double longest_file;   // slowest single file
+    long long bytes;
+    int files;
+} __attribute__((aligned(64))) ThreadStats;
+
+// Final results: restored cities first, then this run's (sized in main)
+static CityStats* cities = NULL;
 static int city_count = 0;
 
 // File list for parallel processing
-static char file_paths[MAX_FILES][512];
-static char city_names[MAX_FILES][MAX_NAME];
-static int num_files = 0;
-
-double get_time_sec(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
-}
+static FileList file_list;
+
+// stdio buffer size passed to process_city_file_phased (0 = BUFSIZ)
+static int io_buffer_size = 0;
+
+// One scratch arena per OpenMP thread, indexed by omp_get_thread_num()
+static Arena* worker_arenas = NULL;
+static int num_worker_arenas = 0;
 
-char* get_field(char* line, int field_num, char* buffer, int buf_size) {
-    int current_field = 0;
-    char* start = line;
-    char* end;
+// One checkpoint log per OpenMP thread (NULL = checkpointing disabled)
+static CheckpointLog* ckpt_logs = NULL;
 
-    while (current_field < field_num) {
-        start = strchr(start, ',');
-        if (!start) {
-            buffer[0] = '\0';
-            return buffer;
+// One bounded heap per OpenMP thread for --days (NULL = query disabled)
+static DaySink* day_sinks = NULL;
+
+// One counter group per OpenMP thread for --counters (NULL = disabled);
+// thread 0 is the main thread and keeps its group open for the whole run
+static PerfCounters* perf_counters = NULL;
+
+// One phase timer per OpenMP thread (NULL while auto-tuning); thread 0 is
+// the main thread, which also times enumerate, reduce and report
+static PhaseTimer* phase_timers = NULL;
+
+// --resume: keep the results of files already in the checkpoint and drop
+// those files from the work list. Returns the number of cities restored.
+static int resume_from_checkpoint(const char* dir) {
+    CheckpointSet set;
+    ckpt_load(dir, sizeof(CityStats), &set);
+
+    int kept = 0;
+    for (int f = 0; f < file_list.count; f++) {
+        const CityStats* done = ckpt_find(&set, file_list_name(&file_list, f));
+        if (done) {
+            cities[city_count++] = *done;
+            continue;
         }
-        start++;
-        current_field++;
+        if (kept != f) file_list_move(&file_list, kept, f);
+        kept++;
     }
+    file_list.count = kept;
 
-    end = strchr(start, ',');
-    if (!end) {
-        end = strchr(start, '\n');
-        if (!end) end = start + strlen(start);
-    }
+    ckpt_free_set(&set);
+    return city_count;
+}
 
-    int len = end - start;
-    if (len >= buf_size) len = buf_size - 1;
-    strncpy(buffer, start, len);
-    buffer[len] = '\0';
+/**
+ * --days: merge the per-thread heaps and print the top N daily records
+ *
+ * Each thread kept only its best N records while parsing, so the merge
+ * touches threads * N records rather than every row of the dataset.
+ */
+static void print_day_ranking(DaySink* sinks, int threads, long n, DayMetric metric) {
+    double t0 = phase_clock();
+    DaySink merged;
+    long candidates = 0;
+    day_sink_init(&merged, n, metric);
+    for (int t = 0; t < threads; t++) {
+        candidates += sinks[t].count;
+        if (day_sink_merge(&merged, &sinks[t]) != 0) {
+            fprintf(stderr, "malloc failed merging day rankings\n");
+            return;
+        }
+    }
+    day_sink_sort(&merged);
+    double select_time = phase_clock() - t0;
 
-    return buffer;
+    printf("\n========== TOP %ld %s DAYS ==========\n", n, day_metric_name(metric));
+    printf("%-6s %-30s %12s %12s\n", "Rank", "City", "Date", metric == DAYS_WETTEST ? "Precip (mm)" : "Avg Temp");
+    printf("--------------------------------------------------------------------------------\n");
+    for (long i = 0; i < merged.count; i++) {
+        const DayRecord* d = &merged.recs[i];
+        char date[16];
+        snprintf(date, sizeof(date), "%04d-%02d-%02d", d->date / 10000, d->date / 100 % 100, d->date % 100);
+        printf("%-6ld %-30s %12s %12.2f\n", i + 1, file_list_name(&file_list, d->city), date, day_value(d, metric));
+    }
+    printf("Daily records ranked: %ld (%d thread heaps of %ld, %ld candidates merged) in %.3f seconds\n",
+           merged.seen, threads, n, candidates, select_time);
+    day_sink_free(&merged);
 }
 
-int get_month(const char* date) {
-    if (strlen(date) < 7) return -1;
-    char month_str[3] = {date[5], date[6], '\0'};
-    return atoi(month_str) - 1;
+static const char* schedule_name(omp_sched_t kind) {
+    switch (kind) {
+        case omp_sched_static: return "static";
+        case omp_sched_guided: return "guided";
+        default: return "dynamic";
+    }
 }
 
-void process_city_file(const char* filepath, CityStats* city) {
-    FILE* fp = fopen(filepath, "r");
-    if (!fp) return;
+static omp_sched_t parse_schedule(const char* name) {
+    if (strcmp(name, "static") == 0) return omp_sched_static;
+    if (strcmp(name, "guided") == 0) return omp_sched_guided;
+    return omp_sched_dynamic;  // default
+}
 
-    city->temp_sum = 0;
-    city->temp_min = DBL_MAX;
-    city->temp_max = -DBL_MAX;
-    city->precip_sum = 0;
-    city->temp_count = 0;
-    city->precip_count = 0;
-    city->record_count = 0;
-    memset(city->monthly_temp_sum, 0, sizeof(city->monthly_temp_sum));
-    memset(city->monthly_temp_count, 0, sizeof(city->monthly_temp_count));
+// Make sure every thread of an n-thread team has its own scratch arena
+static int ensure_worker_arenas(int n) {
+    if (n <= num_worker_arenas) return 0;
 
-    char line[MAX_LINE];
-    char field_buf[64];
+    Arena* grown = realloc(worker_arenas, n * sizeof(Arena));
+    if (!grown) return -1;
+    worker_arenas = grown;
 
-    // Skip header
-    if (!fgets(line, MAX_LINE, fp)) {
-        fclose(fp);
-        return;
+    for (int t = num_worker_arenas; t < n; t++) {
+        if (arena_init(&worker_arenas[t], SCRATCH_ARENA_SIZE) != 0) {
+            num_worker_arenas = t;
+            return -1;
+        }
     }
+    num_worker_arenas = n;
+    return 0;
+}
 
-    while (fgets(line, MAX_LINE, fp)) {
-        city->record_count++;
-
-        char date[32];
-        get_field(line, 2, date, sizeof(date));
-        int month = get_month(date);
-
-        get_field(line, 4, field_buf, sizeof(field_buf));
-        if (field_buf[0] != '\0') {
-            double temp = atof(field_buf);
-            city->temp_sum += temp;
-            city->temp_count++;
+// Process a subset of the file list (idx == NULL means files 0..count-1).
+// If tstats is given (cfg->threads entries) per-thread counters are
+// accumulated into it. Returns the wall time of the parallel region.
+static double process_files(const int* idx, int count, CityStats* out, const TuneConfig* cfg,
+                            ThreadStats* tstats) {
+    io_buffer_size = cfg->buffer_size;
+    omp_set_schedule(cfg->schedule, cfg->chunk_size);
+    if (ensure_worker_arenas(cfg->threads) != 0) {
+        fprintf(stderr, "Failed to reserve scratch arenas\n");
+        exit(1);
+    }
 
-            if (temp < city->temp_min) city->temp_min = temp;
-            if (temp > city->temp_max) city->temp_max = temp;
+    double start = phase_clock();
+
+    #pragma omp parallel num_threads(cfg->threads)
+    {
+        int tid = omp_get_thread_num();
+        PerfCounters* pc = perf_counters ? &perf_counters[tid] : NULL;
+        if (pc && tid > 0) perf_open(pc);
+        PhaseTimer tune_timer;
+        PhaseTimer* pt = phase_timers ? &phase_timers[tid] : &tune_timer;
+        if (!phase_timers) phase_timer_init(pt, NULL);
+
+        // nowait: a thread's counters stop before it waits for the others
+        #pragma omp for schedule(runtime) nowait
+        for (int i = 0; i < count; i++) {
+            int f = idx ? idx[i] : i;
+            double t0 = phase_clock();
+
+            strncpy(out[i].name, file_list_name(&file_list, f), MAX_NAME - 1);
+            out[i].name[MAX_NAME - 1] = '\0';
+            const char* path = file_list_path(&file_list, f);
+            DaySink* days = day_sinks ? &day_sinks[tid] : NULL;
+            long bytes = process_city_file_phased(path, &out[i], &worker_arenas[tid], io_buffer_size, days, f, pt);
+            if (bytes < 0) bytes = 0;
+            if (ckpt_logs) {
+                phase_switch(pt, PHASE_IO);
+                ckpt_add(&ckpt_logs[tid], &out[i]);
+            }
 
-            if (month >= 0 && month < 12) {
-                city->monthly_temp_sum[month] += temp;
-                city->monthly_temp_count[month]++;
+            if (tstats) {
+                double t = phase_clock() - t0;
+                ThreadStats* ts = &tstats[tid];
+                ts->busy_time += t;
+                ts->bytes += bytes;
+                ts->files++;
+                if (t > ts->longest_file) ts->longest_file = t;
             }
         }
 
-        get_field(line, 7, field_buf, sizeof(field_buf));
-        if (field_buf[0] != '\0') {
-            double precip = atof(field_buf);
-            city->precip_sum += precip;
-            city->precip_count++;
-        }
+        phase_switch(pt, PHASE_NONE);
+        if (pc && tid > 0) perf_close(pc);
     }
 
-    fclose(fp);
+    return phase_clock() - start;
 }
 
-void collect_files(const char* data_dir, int max_cities) {
-    DIR* dir = opendir(data_dir);
-    if (!dir) {
-        perror("Failed to open directory");
-        return;
+// Max/mean busy time across threads (1 = perfectly balanced)
+static double busy_imbalance(const ThreadStats* tstats, int threads) {
+    double busy_sum = 0, busy_max = 0;
+    for (int t = 0; t < threads; t++) {
+        busy_sum += tstats[t].busy_time;
+        if (tstats[t].busy_time > busy_max) busy_max = tstats[t].busy_time;
     }
+    return busy_sum > 0 ? busy_max * threads / busy_sum : 1.0;
+}
 
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL && num_files < max_cities) {
-        char* ext = strrchr(entry->d_name, '.');
-        if (!ext || strcmp(ext, ".csv") != 0) continue;
+static void print_thread_stats(const ThreadStats* tstats, int threads, double wall) {
+    double busy_sum = 0, busy_max = 0, longest = 0;
+    long long bytes_sum = 0;
 
-        snprintf(file_paths[num_files], sizeof(file_paths[0]), "%s/%s", data_dir, entry->d_name);
+    printf("\n========== THREAD LOAD BALANCE ==========\n");
+    printf("%-8s %10s %10s %8s %12s %14s\n", "Thread", "Busy(s)", "Idle(s)", "Files", "MB", "Longest(s)");
+    printf("--------------------------------------------------------------------------------\n");
+    for (int t = 0; t < threads; t++) {
+        const ThreadStats* ts = &tstats[t];
+        double idle = wall - ts->busy_time;
+        if (idle < 0) idle = 0;
+        printf("%-8d %10.3f %10.3f %8d %12.2f %14.4f\n", t, ts->busy_time, idle,
+               ts->files, ts->bytes / 1e6, ts->longest_file);
+
+        busy_sum += ts->busy_time;
+        bytes_sum += ts->bytes;
+        if (ts->busy_time > busy_max) busy_max = ts->busy_time;
+        if (ts->longest_file > longest) longest = ts->longest_file;
+    }
 
-        strncpy(city_names[num_files], entry->d_name, MAX_NAME - 1);
-        city_names[num_files][MAX_NAME - 1] = '\0';
-        char* dot = strrchr(city_names[num_files], '.');
-        if (dot) *dot = '\0';
+    double busy_mean = busy_sum / threads;
+    printf("Bytes processed: %.2f MB\n", bytes_sum / 1e6);
+    printf("Longest single file: %.4f seconds\n", longest);
+    printf("Imbalance (max/mean busy): %.3f\n", busy_mean > 0 ? busy_max / busy_mean : 1.0);
+    printf("Parallel efficiency: %.1f%%\n", wall > 0 ? 100.0 * busy_sum / (threads * wall) : 0);
+}
 
-        for (char* p = city_names[num_files]; *p; p++) {
-            if (*p == '_') *p = ' ';
-        }
+// FNV-1a, used for the dataset fingerprint
+static unsigned long long fnv1a(unsigned long long h, const void* data, size_t len) {
+    const unsigned char* p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
 
-        num_files++;
+// Identify the dataset by file count, all city names and the sizes of a
+// strided sample of files (stat-ing every file would cost a metadata storm)
+static unsigned long long dataset_fingerprint(void) {
+    unsigned long long h = 1469598103934665603ULL;
+    h = fnv1a(h, &file_list.count, sizeof(file_list.count));
+    for (int i = 0; i < file_list.count; i++) {
+        const char* name = file_list_name(&file_list, i);
+        h = fnv1a(h, name, strlen(name));
     }
 
-    closedir(dir);
+    int stride = file_list.count / TUNE_MAX_SAMPLE + 1;
+    for (int i = 0; i < file_list.count; i += stride) {
+        struct stat st;
+        long long size = stat(file_list_path(&file_list, i), &st) == 0 ? (long long)st.st_size : -1;
+        h = fnv1a(h, &size, sizeof(size));
+    }
+    return h;
 }
 
-void print_results(void) {
-    printf("\n========== WEATHER ANALYSIS RESULTS ==========\n\n");
-
-    // Sort by average temperature (descending)
-    for (int i = 0; i < city_count - 1; i++) {
-        for (int j = i + 1; j < city_count; j++) {
-            double avg_i = cities[i].temp_count > 0 ? cities[i].temp_sum / cities[i].temp_count : -999;
-            double avg_j = cities[j].temp_count > 0 ? cities[j].temp_sum / cities[j].temp_count : -999;
-            if (avg_j > avg_i) {
-                CityStats temp = cities[i];
-                cities[i] = cities[j];
-                cities[j] = temp;
-            }
-        }
+// Tune file: --tune-file, then $WEATHER_TUNE_FILE, then ~/.weather_omp_tune
+static void tune_file_path(char* buf, size_t size, const char* override) {
+    const char* env = getenv("WEATHER_TUNE_FILE");
+    const char* home = getenv("HOME");
+    if (override) snprintf(buf, size, "%s", override);
+    else if (env) snprintf(buf, size, "%s", env);
+    else if (home) snprintf(buf, size, "%s/%s", home, TUNE_FILE_NAME);
+    else snprintf(buf, size, "%s", TUNE_FILE_NAME);
+}
+
+// Each line: <host> <fingerprint> <threads> <schedule> <chunk> <buffer> <seconds>
+static int load_tuned_config(const char* path, const char* host, unsigned long long fp, TuneConfig* cfg) {
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+
+    char line[MAX_LINE];
+    int found = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char h[256], sched[32];
+        unsigned long long lfp;
+        int threads, chunk, buffer;
+        double secs;
+        if (sscanf(line, "%255s %llx %d %31s %d %d %lf",
+                   h, &lfp, &threads, sched, &chunk, &buffer, &secs) != 7) continue;
+        if (strcmp(h, host) != 0 || lfp != fp) continue;
+        if (threads < 1 || chunk < 1 || buffer < 0) continue;
+
+        cfg->threads = threads;
+        cfg->schedule = parse_schedule(sched);
+        cfg->chunk_size = chunk;
+        cfg->buffer_size = buffer;
+        found = 1;
     }
 
-    printf("TOP 10 HOTTEST CITIES (by average temperature):\n");
-    printf("%-25s %10s %10s %10s %12s\n", "City", "Avg(°C)", "Min(°C)", "Max(°C)", "Records");
-    printf("--------------------------------------------------------------------------------\n");
-    for (int i = 0; i < 10 && i < city_count; i++) {
-        CityStats* c = &cities[i];
-        if (c->temp_count > 0) {
-            printf("%-25s %10.2f %10.2f %10.2f %12d\n",
-                   c->name,
-                   c->temp_sum / c->temp_count,
-                   c->temp_min,
-                   c->temp_max,
-                   c->record_count);
-        }
+    fclose(f);
+    return found;
+}
+
+// Replace (or add) the entry for host+fingerprint, keeping all other entries
+static int save_tuned_config(const char* path, const char* host, unsigned long long fp,
+                             const TuneConfig* cfg, double seconds) {
+    char tmp_path[1100];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE* out = fopen(tmp_path, "w");
+    if (!out) {
+        perror("Failed to write tune file");
+        return -1;
     }
 
-    printf("\nTOP 10 COLDEST CITIES (by average temperature):\n");
-    printf("%-25s %10s %10s %10s %12s\n", "City", "Avg(°C)", "Min(°C)", "Max(°C)", "Records");
-    printf("--------------------------------------------------------------------------------\n");
-    for (int i = city_count - 1; i >= city_count - 10 && i >= 0; i--) {
-        CityStats* c = &cities[i];
-        if (c->temp_count > 0) {
-            printf("%-25s %10.2f %10.2f %10.2f %12d\n",
-                   c->name,
-                   c->temp_sum / c->temp_count,
-                   c->temp_min,
-                   c->temp_max,
-                   c->record_count);
+    FILE* in = fopen(path, "r");
+    if (in) {
+        char line[MAX_LINE];
+        while (fgets(line, sizeof(line), in)) {
+            char h[256];
+            unsigned long long lfp;
+            if (sscanf(line, "%255s %llx", h, &lfp) == 2 && strcmp(h, host) == 0 && lfp == fp) continue;
+            fputs(line, out);
         }
+        fclose(in);
     }
 
-    printf("\nTOP 10 WETTEST CITIES (by total precipitation):\n");
-    printf("%-25s %15s %12s\n", "City", "Total(mm)", "Days w/Rain");
-    printf("--------------------------------------------------------------------------------\n");
+    fprintf(out, "%s %016llx %d %s %d %d %.6f\n", host, fp, cfg->threads,
+            schedule_name(cfg->schedule), cfg->chunk_size, cfg->buffer_size, seconds);
+    fclose(out);
 
-    for (int i = 0; i < city_count - 1; i++) {
-        for (int j = i + 1; j < city_count; j++) {
-            if (cities[j].precip_sum > cities[i].precip_sum) {
-                CityStats temp = cities[i];
-                cities[i] = cities[j];
-                cities[j] = temp;
-            }
-        }
+    if (rename(tmp_path, path) != 0) {
+        perror("Failed to replace tune file");
+        return -1;
     }
+    return 0;
+}
 
-    for (int i = 0; i < 10 && i < city_count; i++) {
-        CityStats* c = &cities[i];
-        printf("%-25s %15.2f %12d\n", c->name, c->precip_sum, c->precip_count);
+// Best-of-TUNE_REPS wall time of one calibration pass
+static double tune_measure(const int* idx, int count, CityStats* scratch, const TuneConfig* cfg) {
+    double best = DBL_MAX;
+    for (int r = 0; r < TUNE_REPS; r++) {
+        double t0 = phase_clock();
+        process_files(idx, count, scratch, cfg, NULL);
+        double t = phase_clock() - t0;
+        if (t < best) best = t;
     }
+    return best;
+}
 
-    printf("\n========== OVERALL STATISTICS ==========\n");
-    long total_records = 0;
-    double global_temp_sum = 0;
-    int global_temp_count = 0;
+static void tune_set(TuneConfig* cfg, int dim, int value) {
+    switch (dim) {
+        case 0: cfg->threads = value; break;
+        case 1: cfg->schedule = (omp_sched_t)value; break;
+        case 2: cfg->chunk_size = value; break;
+        default: cfg->buffer_size = value; break;
+    }
+}
 
-    for (int i = 0; i < city_count; i++) {
-        total_records += cities[i].record_count;
-        global_temp_sum += cities[i].temp_sum;
-        global_temp_count += cities[i].temp_count;
+/**
+ * Budgeted coordinate descent over threads, schedule, chunk size and
+ * stdio buffer size. Each candidate runs on a strided sample of the file
+ * list; a move is only accepted if it is at least 2% faster, so noise does
+ * not drift the result. The sample lives in its own arena, released on
+ * return. Returns the best calibration pass time.
+ */
+static double autotune(TuneConfig* cfg, double budget) {
+    int max_threads = omp_get_num_procs();
+
+    int sample = file_list.count / 10;
+    if (sample < 8 * max_threads) sample = 8 * max_threads;
+    if (sample > TUNE_MAX_SAMPLE) sample = TUNE_MAX_SAMPLE;
+    if (sample > file_list.count) sample = file_list.count;
+
+    Arena tune_arena;
+    if (arena_init(&tune_arena, (size_t)sample * (sizeof(int) + sizeof(CityStats))) != 0) {
+        perror("Auto-tune: failed to reserve sample arena");
+        return 0;
+    }
+    int* idx = arena_alloc(&tune_arena, sample * sizeof(int));
+    CityStats* scratch = arena_alloc(&tune_arena, sample * sizeof(CityStats));
+    for (int i = 0; i < sample; i++) {
+        idx[i] = (int)((long)i * file_list.count / sample);
+    }
+
+    // Candidate values per dimension
+    int values[4][16];
+    int nvalues[4] = {0, 0, 0, 0};
+    for (int t = 1; t < max_threads; t *= 2) values[0][nvalues[0]++] = t;
+    values[0][nvalues[0]++] = max_threads;
+    values[1][nvalues[1]++] = omp_sched_static;
+    values[1][nvalues[1]++] = omp_sched_dynamic;
+    values[1][nvalues[1]++] = omp_sched_guided;
+    for (int c = 1; c <= 32; c *= 2) values[2][nvalues[2]++] = c;
+    values[3][nvalues[3]++] = 0;
+    for (int b = 16384; b <= 1048576; b *= 4) values[3][nvalues[3]++] = b;
+
+    printf("Calibration sample: %d files, budget %.1f s\n", sample, budget);
+
+    double start = phase_clock();
+    process_files(idx, sample, scratch, cfg, NULL);  // warm the page cache
+    double best_time = tune_measure(idx, sample, scratch, cfg);
+
+    for (int pass = 0; pass < 2; pass++) {
+        int improved = 0;
+        for (int dim = 0; dim < 4; dim++) {
+            for (int v = 0; v < nvalues[dim]; v++) {
+                if (phase_clock() - start > budget) goto done;
+
+                TuneConfig candidate = *cfg;
+                tune_set(&candidate, dim, values[dim][v]);
+                if (memcmp(&candidate, cfg, sizeof(TuneConfig)) == 0) continue;
+                if (candidate.chunk_size * candidate.threads > sample) continue;
+
+                double t = tune_measure(idx, sample, scratch, &candidate);
+                printf("  threads=%-3d schedule=%-8s chunk=%-3d buffer=%-8d %.4f s\n",
+                       candidate.threads, schedule_name(candidate.schedule),
+                       candidate.chunk_size, candidate.buffer_size, t);
+                if (t < best_time * 0.98) {
+                    *cfg = candidate;
+                    best_time = t;
+                    improved = 1;
+                }
+            }
+        }
+        if (!improved) break;
     }
 
-    printf("Total cities analyzed: %d\n", city_count);
-    printf("Total records processed: %ld\n", total_records);
-    printf("Global average temperature: %.2f°C\n",
-           global_temp_count > 0 ? global_temp_sum / global_temp_count : 0);
+done:
+    printf("Auto-tune finished in %.2f s\n", phase_clock() - start);
+    arena_free(&tune_arena);
+    return best_time;
 }
 
+// In the unified front end (frontend/weather.c) this is the backend entry point
+#ifdef WEATHER_FRONTEND
+#define main weather_omp_main
+#endif
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <data_directory> [max_cities] [num_threads] [schedule] [chunk_size]\n", argv[0]);
+    int autotune_mode = 0;
+    double tune_budget = TUNE_DEFAULT_BUDGET;
+    const char* tune_file = NULL;
+    const char* ckpt_dir = NULL;
+    double ckpt_interval = CKPT_DEFAULT_INTERVAL;
+    int resume = 0;
+    int days_query = 0;
+    DayMetric days_metric = DAYS_HOTTEST;
+    long days_n = DAYS_DEFAULT_N;
+    int counters = 0;
+    BenchConfig bench;
+    bench_init(&bench);
+
+    // Split --options from positional arguments
+    const char* pos[5];
+    int npos = 0;
+    for (int i = 1; i < argc; i++) {
+        if (bench_parse_option(&bench, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--autotune") == 0) autotune_mode = 1;
+        else if (strcmp(argv[i], "--tune-budget") == 0 && i + 1 < argc) tune_budget = atof(argv[++i]);
+        else if (strcmp(argv[i], "--tune-file") == 0 && i + 1 < argc) tune_file = argv[++i];
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) ckpt_dir = argv[++i];
+        else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) ckpt_interval = atof(argv[++i]);
+        else if (strcmp(argv[i], "--resume") == 0) resume = 1;
+        else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) days_query = parse_day_metric(argv[++i], &days_metric) == 0;
+        else if (strcmp(argv[i], "--days-n") == 0 && i + 1 < argc) days_n = atol(argv[++i]);
+        else if (strcmp(argv[i], "--counters") == 0) counters = 1;
+        else if (npos < 5) pos[npos++] = argv[i];
+    }
+
+    if (npos < 1) {
+        printf("Usage: %s <data_directory> [max_cities] [num_threads] [schedule] [chunk_size] [options]\n", argv[0]);
         printf("  schedule: static, dynamic, guided (default: dynamic)\n");
         printf("  chunk_size: iterations per chunk (default: 1)\n");
+        printf("Options:\n");
+        printf("  --autotune           calibrate threads/schedule/chunk/buffer and save the result\n");
+        printf("  --tune-budget <sec>  calibration time budget (default: %.0f)\n", TUNE_DEFAULT_BUDGET);
+        printf("  --tune-file <path>   tune file (default: $WEATHER_TUNE_FILE or ~/%s)\n", TUNE_FILE_NAME);
+        printf("  --checkpoint <dir>   append finished cities to per-thread logs in <dir>\n");
+        printf("  --checkpoint-interval <sec>  seconds between appends (default: %.0f)\n", CKPT_DEFAULT_INTERVAL);
+        printf("  --resume             skip files already recorded in the checkpoint\n");
+        printf("  --days <metric>      rank individual days: hottest, coldest, wettest\n");
+        printf("  --days-n <N>         days listed by --days (default: %d)\n", DAYS_DEFAULT_N);
+        printf("  --counters           hardware counters (cycles, IPC, cache/branch/TLB misses) per phase\n");
+        printf("                       and thread\n");
+        bench_usage();
+        printf("If num_threads, schedule and chunk_size are omitted, a saved tuning for\n");
+        printf("this host and dataset is loaded automatically.\n");
         printf("Example: %s ../data/cities 100 4 dynamic 16\n", argv[0]);
         return 1;
     }
 
-    const char* data_dir = argv[1];
-    int max_cities = MAX_CITIES;
+    if (bench.reps > 0 && ckpt_dir) {
+        fprintf(stderr, "--bench cannot be combined with --checkpoint\n");
+        return 1;
+    }
+
+    const char* data_dir = pos[0];
+    int max_cities = MAX_CITIES_ALL;
     int num_threads = omp_get_max_threads();
     const char* schedule_type = "dynamic";
     int chunk_size = 1;
 
-    if (argc >= 3) max_cities = atoi(argv[2]);
-    if (argc >= 4) num_threads = atoi(argv[3]);
-    if (argc >= 5) schedule_type = argv[4];
-    if (argc >= 6) chunk_size = atoi(argv[5]);
+    if (npos >= 2) max_cities = parse_max_cities(pos[1]);
+    if (npos >= 3) num_threads = atoi(pos[2]);
+    if (npos >= 4) schedule_type = pos[3];
+    if (npos >= 5) chunk_size = atoi(pos[4]);
 
     omp_set_num_threads(num_threads);
 
     printf("Weather Analysis - OpenMP Parallel Version\n");
     printf("Data directory: %s\n", data_dir);
-    printf("Max cities: %d\n", max_cities);
-    printf("Threads: %d\n", num_threads);
-    printf("Schedule: %s\n", schedule_type);
-    printf("Chunk size: %d\n", chunk_size);
+    if (max_cities == MAX_CITIES_ALL) printf("Max cities: all\n");
+    else printf("Max cities: %d\n", max_cities);
+
+    // The main thread times (and with --counters counts) from the directory scan on
+    PerfCounters main_perf;
+    perf_init(&main_perf);
+    if (counters) perf_open(&main_perf);
+    PhaseTimer main_timer;
+    phase_timer_init(&main_timer, counters ? &main_perf : NULL);
 
     // Collect file list first (serial)
-    collect_files(data_dir, max_cities);
-    printf("Files found: %d\n", num_files);
+    phase_switch(&main_timer, PHASE_ENUMERATE);
+    file_list_init(&file_list);
+    file_list_scan(&file_list, data_dir, max_cities, 0);
+    printf("Files found: %d\n", file_list.count);
+    phase_switch(&main_timer, PHASE_NONE);
+
+    TuneConfig cfg = {num_threads, parse_schedule(schedule_type), chunk_size, 0};
+
+    // Explicit threads/schedule/chunk always win over a saved tuning
+    if (autotune_mode || npos < 3) {
+        char host[256];
+        if (gethostname(host, sizeof(host)) != 0) strcpy(host, "unknown");
+        host[sizeof(host) - 1] = '\0';
+
+        char path[1024];
+        tune_file_path(path, sizeof(path), tune_file);
+        unsigned long long fp = dataset_fingerprint();
+
+        if (autotune_mode && file_list.count > 0) {
+            double best = autotune(&cfg, tune_budget);
+            if (save_tuned_config(path, host, fp, &cfg, best) == 0) {
+                printf("Tuned configuration saved to %s\n", path);
+            }
+        } else if (load_tuned_config(path, host, fp, &cfg)) {
+            printf("Loaded tuned configuration from %s\n", path);
+        }
+    }
 
-    double start_time = get_time_sec();
+    // Run-lifetime allocations (results, thread counters), reserved once
+    // tuning has settled the thread count
+    Arena run_arena;
+    size_t run_bytes = (size_t)file_list.count * 2 * sizeof(CityStats)
+                     + (size_t)cfg.threads * sizeof(ThreadStats);
+    if (arena_init(&run_arena, run_bytes) != 0) {
+        perror("Failed to reserve run arena");
+        return 1;
+    }
+    cities = arena_alloc(&run_arena, (size_t)file_list.count * sizeof(CityStats));
+
+    printf("Threads: %d\n", cfg.threads);
+    printf("Schedule: %s\n", schedule_name(cfg.schedule));
+    printf("Chunk size: %d\n", cfg.chunk_size);
+    printf("I/O buffer: %d bytes%s\n", cfg.buffer_size, cfg.buffer_size == 0 ? " (default)" : "");
+
+    // Checkpointing: one append-only log per thread
+    CheckpointLog* logs = NULL;
+    int resumed = 0;
+    if (ckpt_dir) {
+        mkdir(ckpt_dir, 0755);
+        if (resume) {
+            resumed = resume_from_checkpoint(ckpt_dir);
+            printf("Resumed from checkpoint: %d cities restored, %d files left\n", resumed, file_list.count);
+        } else {
+            ckpt_clear(ckpt_dir);
+        }
 
-    // Thread-local results
-    CityStats* local_cities = malloc(num_files * sizeof(CityStats));
-
-    // Process files in parallel with configurable chunk size
-    if (strcmp(schedule_type, "static") == 0) {
-        #pragma omp parallel for schedule(static, chunk_size)
-        for (int i = 0; i < num_files; i++) {
-            strncpy(local_cities[i].name, city_names[i], MAX_NAME);
-            process_city_file(file_paths[i], &local_cities[i]);
+        logs = calloc(cfg.threads, sizeof(CheckpointLog));
+        if (!logs) {
+            fprintf(stderr, "malloc failed for checkpoint logs\n");
+            return 1;
         }
-    } else if (strcmp(schedule_type, "guided") == 0) {
-        #pragma omp parallel for schedule(guided, chunk_size)
-        for (int i = 0; i < num_files; i++) {
-            strncpy(local_cities[i].name, city_names[i], MAX_NAME);
-            process_city_file(file_paths[i], &local_cities[i]);
+        for (int t = 0; t < cfg.threads; t++) {
+            char worker[32];
+            snprintf(worker, sizeof(worker), "thread%d", t);
+            if (ckpt_open(&logs[t], ckpt_dir, worker, sizeof(CityStats), ckpt_interval) != 0) {
+                perror("Failed to open checkpoint log");
+                return 1;
+            }
         }
-    } else {  // dynamic (default)
-        #pragma omp parallel for schedule(dynamic, chunk_size)
-        for (int i = 0; i < num_files; i++) {
-            strncpy(local_cities[i].name, city_names[i], MAX_NAME);
-            process_city_file(file_paths[i], &local_cities[i]);
+        ckpt_logs = logs;
+        printf("Checkpoint: %s every %.1f seconds\n", ckpt_dir, ckpt_interval);
+    }
+
+    DaySink* sinks = NULL;
+    if (days_query) {
+        if (days_n < 1) days_n = DAYS_DEFAULT_N;
+        sinks = malloc(cfg.threads * sizeof(DaySink));
+        if (!sinks) {
+            fprintf(stderr, "malloc failed for day heaps\n");
+            return 1;
         }
+        for (int t = 0; t < cfg.threads; t++) day_sink_init(&sinks[t], days_n, days_metric);
+        day_sinks = sinks;
+        if (resumed > 0) printf("Note: days of the %d restored cities are not ranked\n", resumed);
     }
 
-    // Copy results to global array
-    for (int i = 0; i < num_files; i++) {
-        cities[i] = local_cities[i];
+    // Counter groups and phase timers once the thread count is final; the
+    // tuner is neither counted nor timed
+    PerfCounters* perf = NULL;
+    if (counters) {
+        perf = malloc(cfg.threads * sizeof(PerfCounters));
+        if (!perf) {
+            fprintf(stderr, "malloc failed for counters\n");
+            return 1;
+        }
+        for (int t = 1; t < cfg.threads; t++) perf_init(&perf[t]);
+        perf[0] = main_perf;
+        perf_counters = perf;
+    }
+    PhaseTimer* timers = malloc(cfg.threads * sizeof(PhaseTimer));
+    if (!timers) {
+        fprintf(stderr, "malloc failed for phase timers\n");
+        return 1;
     }
-    city_count = num_files;
+    for (int t = 0; t < cfg.threads; t++) phase_timer_init(&timers[t], perf ? &perf[t] : NULL);
+    timers[0].seconds[PHASE_ENUMERATE] = main_timer.seconds[PHASE_ENUMERATE];
+    phase_timers = timers;
 
-    free(local_cities);
+    // Thread-local results
+    CityStats* local_cities = arena_alloc(&run_arena, file_list.count * sizeof(CityStats));
+
+    ThreadStats* tstats = arena_alloc(&run_arena, cfg.threads * sizeof(ThreadStats));
+    if (!local_cities || !tstats) {
+        fprintf(stderr, "Run arena exhausted\n");
+        return 1;
+    }
+    int runs = bench_start(&bench);
+    if (runs == 0) {
+        fprintf(stderr, "malloc failed for benchmark times\n");
+        return 1;
+    }
+
+    // One run, or the warmup and timed runs of --bench
+    double elapsed = 0, parallel_time = 0;
+    for (int run = 0; run < runs; run++) {
+        memset(tstats, 0, cfg.threads * sizeof(ThreadStats));
+        for (int t = 0; t < cfg.threads; t++) phase_restart(&timers[t]);
+        for (int t = 0; sinks && t < cfg.threads; t++) {
+            sinks[t].count = 0;
+            sinks[t].seen = 0;
+        }
+
+        double start_time = phase_clock();
+
+        // Process files in parallel with the selected schedule and chunk size
+        parallel_time = process_files(NULL, file_list.count, local_cities, &cfg, tstats);
+
+        // Final append so a finished run leaves a complete checkpoint
+        phase_switch(&timers[0], PHASE_IO);
+        for (int t = 0; logs && t < cfg.threads; t++) ckpt_close(&logs[t]);
+        ckpt_logs = NULL;
+
+        // Copy results to global array, after any restored from the checkpoint
+        phase_switch(&timers[0], PHASE_REDUCE);
+        for (int i = 0; i < file_list.count; i++) {
+            cities[resumed + i] = local_cities[i];
+        }
+        city_count = resumed + file_list.count;
+        phase_switch(&timers[0], PHASE_NONE);
 
-    double end_time = get_time_sec();
-    double elapsed = end_time - start_time;
+        elapsed = phase_clock() - start_time;
+        bench_record(&bench, run, elapsed);
+    }
+
+    phase_switch(&timers[0], PHASE_REPORT);
+    print_results(cities, city_count);
 
-    print_results();
+    if (sinks) {
+        day_sinks = NULL;
+        print_day_ranking(sinks, cfg.threads, days_n, days_metric);
+        for (int t = 0; t < cfg.threads; t++) day_sink_free(&sinks[t]);
+        free(sinks);
+    }
 
     printf("\n========== PERFORMANCE ==========\n");
     printf("Processing time: %.3f seconds\n", elapsed);
     printf("Cities processed: %d\n", city_count);
-    printf("Threads used: %d\n", num_threads);
+    printf("Threads used: %d\n", cfg.threads);
     printf("Throughput: %.2f cities/second\n", city_count / elapsed);
 
-    return 0;
+    print_thread_stats(tstats, cfg.threads, parallel_time);
+    if (logs) {
+        print_checkpoint_stats("Thread", logs, cfg.threads, elapsed);
+        free(logs);
+    }
+
+    print_arena_stats("Run", &run_arena, 1);
+    print_arena_stats("Scratch", worker_arenas, num_worker_arenas);
+    printf("Peak RSS: %.1f MB\n", peak_rss_kb() / 1024.0);
+    phase_switch(&timers[0], PHASE_NONE);
+
+    double* phase_seconds = malloc(cfg.threads * NUM_PHASES * sizeof(double));
+    if (phase_seconds) {
+        phase_collect(timers, cfg.threads, phase_seconds);
+        phase_report(phase_seconds, cfg.threads);
+        free(phase_seconds);
+    }
+    phase_timers = NULL;
+    free(timers);
+
+    if (perf) {
+        perf_close(&perf[0]);
+        PerfTotals* totals = malloc(cfg.threads * sizeof(PerfTotals));
+        if (totals) {
+            for (int t = 0; t < cfg.threads; t++) totals[t] = perf[t].t;
+            perf_report(totals, 0, cfg.threads, phase_names, NUM_PHASES);
+            free(totals);
+        }
+        perf_counters = NULL;
+        free(perf);
+    }
+
+    char bench_config[128];
+    snprintf(bench_config, sizeof(bench_config), "threads=%d schedule=%s chunk=%d", cfg.threads,
+             schedule_name(cfg.schedule), cfg.chunk_size);
+    int rc = bench_report(&bench, "omp", bench_config, cfg.threads, busy_imbalance(tstats, cfg.threads),
+                          data_dir, city_count) == 0 ? 0 : 1;
+    bench_free(&bench);
+
+    for (int t = 0; t < num_worker_arenas; t++) arena_free(&worker_arenas[t]);
+    free(worker_arenas);
+    arena_free(&run_arena);
+    file_list_free(&file_list);
+
+    return rc;
 }
@@ -0,0 +1,70 @@
+#!/bin/bash
+
+# Weather Analysis - Build Variant Comparison
+# Times the default serial/OpenMP/MPI binaries against an optimised variant
+# (binaries with the suffix _<variant>, e.g. _pgo or _lto) and records the
+# speedup in results/<variant>_results.csv.
+#
+# Usage: compare_builds.sh <variant> <data_dir> [trials]
+
+set -e
+
+VARIANT=$1
+DATA_DIR=$2
+TRIALS=${3:-5}
+
+if [ -z "$VARIANT" ] || [ -z "$DATA_DIR" ]; then
+    echo "Usage: $0 <variant> <data_dir> [trials]"
+    exit 1
+fi
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+RESULTS_DIR="$PROJECT_DIR/results"
+RESULTS="$RESULTS_DIR/${VARIANT}_results.csv"
+
+MPIRUN=${MPIRUN:-"mpirun --oversubscribe"}
+OMP_THREADS=${OMP_THREADS:-4}
+MPI_PROCS=${MPI_PROCS:-4}
+
+mkdir -p "$RESULTS_DIR"
+echo "backend,default_sec,${VARIANT}_sec,speedup" > "$RESULTS"
+
+# Best "Processing time" over the trials (least disturbed by noise)
+best_time() {
+    local best=""
+    for trial in $(seq 1 $TRIALS); do
+        local t=$("$@" 2>&1 | grep "Processing time:" | awk '{print $3}')
+        if [ -z "$best" ] || awk -v a="$t" -v b="$best" 'BEGIN {exit !(a < b)}'; then
+            best=$t
+        fi
+    done
+    echo "$best"
+}
+
+compare() {
+    local backend=$1
+    shift
+    local base_cmd=("$@")
+    local variant_cmd=()
+    for arg in "${base_cmd[@]}"; do
+        # Swap the binary (the only argument naming an executable) for its variant
+        if [ -x "$arg" ] && [ -f "$arg" ]; then
+            variant_cmd+=("${arg}_${VARIANT}")
+        else
+            variant_cmd+=("$arg")
+        fi
+    done
+
+    local base=$(best_time "${base_cmd[@]}")
+    local opt=$(best_time "${variant_cmd[@]}")
+    local speedup=$(awk -v a="$base" -v b="$opt" 'BEGIN {printf "%.3f", a / b}')
+    echo "  $backend: default ${base}s, $VARIANT ${opt}s, speedup ${speedup}x"
+    echo "$backend,$base,$opt,$speedup" >> "$RESULTS"
+}
+
+echo "Comparing default and $VARIANT builds on $DATA_DIR (best of $TRIALS)"
+compare serial "$PROJECT_DIR/serial/weather_analysis" "$DATA_DIR"
+compare omp "$PROJECT_DIR/parallel_omp/weather_analysis_omp" "$DATA_DIR" all $OMP_THREADS dynamic
+compare mpi $MPIRUN -np $MPI_PROCS "$PROJECT_DIR/distributed_mpi/weather_analysis_mpi" "$DATA_DIR" all blocking block
+echo "Results saved to $RESULTS"
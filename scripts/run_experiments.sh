@@ -7,7 +7,7 @@ set -e
 
 SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
 PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
-DATA_DIR="$PROJECT_DIR/data/cities"
+DATA_DIR=${DATA_DIR:-"$PROJECT_DIR/data/cities"}
 RESULTS_DIR="$PROJECT_DIR/results"
 
 mkdir -p "$RESULTS_DIR"
@@ -16,6 +16,13 @@ mkdir -p "$RESULTS_DIR"
 TRIALS=3
 MAX_CITIES=1234
 
+# Without the Kaggle download (CI, offline hosts) the experiments run on
+# a synthetic dataset of the same shape; the seed makes runs reproducible
+SYNTH_DIR="$PROJECT_DIR/build/synthetic/cities"
+SYNTH_YEARS=${SYNTH_YEARS:-10}
+SYNTH_SEED=${SYNTH_SEED:-42}
+SYNTH_MISSING=${SYNTH_MISSING:-0.02}
+
 echo "=============================================="
 echo "Weather Analysis - Experiment Suite"
 echo "=============================================="
@@ -26,39 +33,39 @@ echo ""
 
 # Compile all versions
 echo "Compiling..."
-cd "$PROJECT_DIR/serial"
-gcc -O2 -o weather_analysis weather_analysis.c -lm
-
-cd "$PROJECT_DIR/parallel_omp"
-gcc -O2 -fopenmp -o weather_analysis_omp weather_analysis_omp.c -lm
-
-cd "$PROJECT_DIR/distributed_mpi"
-mpicc -O2 -o weather_analysis_mpi weather_analysis_mpi.c -lm
+make -C "$PROJECT_DIR" serial omp mpi hybrid gen > /dev/null
 
 echo "Compilation complete."
 echo ""
 
-# Function to run and time experiment
-run_experiment() {
+if [ ! -d "$DATA_DIR" ]; then
+    echo "No dataset at $DATA_DIR, generating $MAX_CITIES synthetic cities"
+    DATA_DIR="$SYNTH_DIR"
+    "$PROJECT_DIR/tools/gen_cities" "$DATA_DIR" $MAX_CITIES $SYNTH_YEARS $SYNTH_SEED --missing $SYNTH_MISSING
+    echo ""
+fi
+
+# SKEW_DIR=synthetic: generate the skewed set for section 3b as well
+if [ "$SKEW_DIR" = "synthetic" ]; then
+    SKEW_DIR="$PROJECT_DIR/build/synthetic/skewed"
+    "$PROJECT_DIR/tools/gen_cities" "$SKEW_DIR" $MAX_CITIES 40 $SYNTH_SEED --missing $SYNTH_MISSING --skew 3
+    echo ""
+fi
+
+# Each configuration is one invocation: the binary does a warmup run,
+# times $TRIALS runs and appends min/median/p90/stddev (plus speedup and
+# efficiency against the serial baseline, when given) to the CSV
+BASELINE="$RESULTS_DIR/serial_baseline.txt"
+
+# run_bench <name> <results.csv> <command...> [--bench-baseline FILE]
+run_bench() {
     local name=$1
-    local cmd=$2
-    local output_file=$3
+    local output_file=$2
+    shift 2
 
     echo "Running: $name"
-    echo "Command: $cmd"
-
-    local times=""
-    for trial in $(seq 1 $TRIALS); do
-        # Run and extract time
-        local result=$($cmd 2>&1 | grep "Processing time:" | awk '{print $3}')
-        times="$times $result"
-        echo "  Trial $trial: ${result}s"
-    done
-
-    # Calculate average
-    local avg=$(echo $times | tr ' ' '\n' | awk '{sum+=$1; count++} END {printf "%.3f", sum/count}')
-    echo "  Average: ${avg}s"
-    echo "$name,$avg" >> "$output_file"
+    "$@" --bench $TRIALS --bench-warmup 1 --bench-out "$output_file" 2>&1 |
+        grep -E "^(Min|Mean|Speedup)" | sed 's/^/  /'
     echo ""
 }
 
@@ -70,13 +77,10 @@ echo "1. Serial Baseline"
 echo "=============================================="
 
 SERIAL_RESULTS="$RESULTS_DIR/serial_results.csv"
-echo "experiment,time_sec" > "$SERIAL_RESULTS"
-
-run_experiment "serial_baseline" \
-    "$PROJECT_DIR/serial/weather_analysis $DATA_DIR $MAX_CITIES" \
-    "$SERIAL_RESULTS"
+rm -f "$SERIAL_RESULTS"
 
-SERIAL_TIME=$(tail -1 "$SERIAL_RESULTS" | cut -d',' -f2)
+run_bench "serial_baseline" "$SERIAL_RESULTS" \
+    "$PROJECT_DIR/serial/weather_analysis" "$DATA_DIR" $MAX_CITIES --bench-baseline "$BASELINE"
 
 # ======================
 # OPENMP SCALING
@@ -86,25 +90,13 @@ echo "2. OpenMP Strong Scaling"
 echo "=============================================="
 
 OMP_RESULTS="$RESULTS_DIR/openmp_results.csv"
-echo "threads,schedule,time_sec,speedup,efficiency" > "$OMP_RESULTS"
+rm -f "$OMP_RESULTS"
 
 for threads in 1 2 4 8; do
     for schedule in static dynamic guided; do
-        echo "Running: OpenMP threads=$threads schedule=$schedule"
-        times=""
-        for trial in $(seq 1 $TRIALS); do
-            result=$("$PROJECT_DIR/parallel_omp/weather_analysis_omp" "$DATA_DIR" $MAX_CITIES $threads $schedule 2>&1 | grep "Processing time:" | awk '{print $3}')
-            times="$times $result"
-            echo "  Trial $trial: ${result}s"
-        done
-
-        avg=$(echo $times | tr ' ' '\n' | awk '{sum+=$1; count++} END {printf "%.3f", sum/count}')
-        speedup=$(echo "scale=3; $SERIAL_TIME / $avg" | bc)
-        efficiency=$(echo "scale=3; $speedup / $threads" | bc)
-
-        echo "  Average: ${avg}s, Speedup: ${speedup}x, Efficiency: ${efficiency}"
-        echo "$threads,$schedule,$avg,$speedup,$efficiency" >> "$OMP_RESULTS"
-        echo ""
+        run_bench "OpenMP threads=$threads schedule=$schedule" "$OMP_RESULTS" \
+            "$PROJECT_DIR/parallel_omp/weather_analysis_omp" "$DATA_DIR" $MAX_CITIES $threads $schedule \
+            --bench-baseline "$BASELINE"
     done
 done
 
@@ -116,25 +108,65 @@ echo "3. MPI Strong Scaling"
 echo "=============================================="
 
 MPI_RESULTS="$RESULTS_DIR/mpi_results.csv"
-echo "processes,comm_mode,time_sec,speedup,efficiency" > "$MPI_RESULTS"
+rm -f "$MPI_RESULTS"
 
 for procs in 1 2 4 8; do
     for comm in blocking nonblocking; do
-        echo "Running: MPI procs=$procs comm=$comm"
-        times=""
-        for trial in $(seq 1 $TRIALS); do
-            result=$(mpirun --oversubscribe -np $procs "$PROJECT_DIR/distributed_mpi/weather_analysis_mpi" "$DATA_DIR" $MAX_CITIES $comm 2>&1 | grep "Processing time:" | awk '{print $3}')
-            times="$times $result"
-            echo "  Trial $trial: ${result}s"
+        for dist in block cyclic balanced dynamic; do
+            run_bench "MPI procs=$procs comm=$comm dist=$dist" "$MPI_RESULTS" \
+                mpirun --oversubscribe -np $procs "$PROJECT_DIR/distributed_mpi/weather_analysis_mpi" \
+                "$DATA_DIR" $MAX_CITIES $comm $dist --bench-baseline "$BASELINE"
         done
+    done
+done
+
+# ======================
+# MPI DISTRIBUTION UNDER SKEW (optional)
+# ======================
+# Set SKEW_DIR to a city directory with deliberately uneven file sizes
+# (e.g. a few 40-year stations among many short ones) to compare how the
+# distribution modes cope with skew, or to "synthetic" to generate one.
+# The imbalance column is the slowest rank's processing time over the mean.
+if [ -n "$SKEW_DIR" ]; then
+    echo "=============================================="
+    echo "3b. MPI Distribution Modes Under Skewed File Sizes"
+    echo "=============================================="
+
+    SKEW_RESULTS="$RESULTS_DIR/mpi_skew_results.csv"
+    rm -f "$SKEW_RESULTS"
+
+    for procs in 2 4 8; do
+        for dist in block cyclic balanced dynamic; do
+            run_bench "MPI skew procs=$procs dist=$dist" "$SKEW_RESULTS" \
+                mpirun --oversubscribe -np $procs "$PROJECT_DIR/distributed_mpi/weather_analysis_mpi" \
+                "$SKEW_DIR" $MAX_CITIES blocking $dist
+        done
+    done
+fi
 
-        avg=$(echo $times | tr ' ' '\n' | awk '{sum+=$1; count++} END {printf "%.3f", sum/count}')
-        speedup=$(echo "scale=3; $SERIAL_TIME / $avg" | bc)
-        efficiency=$(echo "scale=3; $speedup / $procs" | bc)
+# ======================
+# HYBRID SCALING (ranks x threads)
+# ======================
+echo "=============================================="
+echo "4. Hybrid MPI+OpenMP Strong Scaling"
+echo "=============================================="
 
-        echo "  Average: ${avg}s, Speedup: ${speedup}x, Efficiency: ${efficiency}"
-        echo "$procs,$comm,$avg,$speedup,$efficiency" >> "$MPI_RESULTS"
-        echo ""
+HYBRID_RESULTS="$RESULTS_DIR/hybrid_results.csv"
+rm -f "$HYBRID_RESULTS"
+
+# Same total worker counts as the pure OpenMP and MPI sweeps above,
+# split between ranks and threads per rank
+for workers in 1 2 4 8; do
+    for procs in 1 2 4 8; do
+        if [ $procs -gt $workers ]; then
+            continue
+        fi
+        threads=$((workers / procs))
+
+        run_bench "Hybrid procs=$procs threads=$threads" "$HYBRID_RESULTS" \
+            env OMP_NUM_THREADS=$threads mpirun --oversubscribe --bind-to none -np $procs \
+            "$PROJECT_DIR/distributed_mpi/weather_analysis_hybrid" "$DATA_DIR" $MAX_CITIES blocking block $threads \
+            --bench-baseline "$BASELINE"
     done
 done
 
@@ -142,32 +174,23 @@ done
 # WEAK SCALING (varying problem size)
 # ======================
 echo "=============================================="
-echo "4. Weak Scaling (OpenMP)"
+echo "5. Weak Scaling (OpenMP)"
 echo "=============================================="
 
 WEAK_RESULTS="$RESULTS_DIR/weak_scaling_results.csv"
-echo "threads,cities,time_sec,cities_per_thread" > "$WEAK_RESULTS"
+rm -f "$WEAK_RESULTS"
 
 BASE_CITIES=100  # cities per thread
 
+# No serial baseline here: each point processes a different number of cities
 for threads in 1 2 4 8; do
     cities=$((BASE_CITIES * threads))
     if [ $cities -gt $MAX_CITIES ]; then
         cities=$MAX_CITIES
     fi
 
-    echo "Running: Weak scaling threads=$threads cities=$cities"
-    times=""
-    for trial in $(seq 1 $TRIALS); do
-        result=$("$PROJECT_DIR/parallel_omp/weather_analysis_omp" "$DATA_DIR" $cities $threads dynamic 2>&1 | grep "Processing time:" | awk '{print $3}')
-        times="$times $result"
-        echo "  Trial $trial: ${result}s"
-    done
-
-    avg=$(echo $times | tr ' ' '\n' | awk '{sum+=$1; count++} END {printf "%.3f", sum/count}')
-    echo "  Average: ${avg}s"
-    echo "$threads,$cities,$avg,$BASE_CITIES" >> "$WEAK_RESULTS"
-    echo ""
+    run_bench "Weak scaling threads=$threads cities=$cities" "$WEAK_RESULTS" \
+        "$PROJECT_DIR/parallel_omp/weather_analysis_omp" "$DATA_DIR" $cities $threads dynamic
 done
 
 echo "=============================================="
@@ -177,4 +200,5 @@ echo "Results saved to:"
 echo "  - $SERIAL_RESULTS"
 echo "  - $OMP_RESULTS"
 echo "  - $MPI_RESULTS"
+echo "  - $HYBRID_RESULTS"
 echo "  - $WEAK_RESULTS"
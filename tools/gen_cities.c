@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Synthetic city generator
+ *
+ * Writes data/cities-style CSVs (one file per city, Kaggle column schema)
+ * so builds and benchmarks can run without downloading the dataset. Output
+ * depends only on the arguments, never on the thread count: every city
+ * draws its weather from its own generator seeded with (seed, city index),
+ * and its record span and blanked fields from a second, independent
+ * stream, so --missing and --skew leave the remaining values unchanged.
+ *
+ *   --start-year Y   first year of the span (default 1990)
+ *   --missing R      fraction of measurement fields left empty (0-1)
+ *   --skew S         file-size skew: a city covers years * u^S of the span
+ *                    (u uniform), its most recent years; 0 = all equal
+ *   --threads N      cities generated in parallel (default: all cores)
+ */
+
+#define DEFAULT_START_YEAR 1990
+#define IO_BUFFER_SIZE (1 << 20)
+#define MASK_SALT 0x6A09E667F3BCC909ULL
+
+static const char* header =
+    "station_id,city_name,date,season,avg_temp_c,min_temp_c,max_temp_c,precipitation_mm,"
+    "snow_depth_mm,avg_wind_dir_deg,avg_wind_speed_kmh,peak_wind_gust_kmh,"
+    "avg_sea_level_pres_hpa,sunshine_total_min\n";
+
+static const char* season_of_month[12] = {
+    "Winter", "Winter", "Spring", "Spring", "Spring", "Summer",
+    "Summer", "Summer", "Autumn", "Autumn", "Autumn", "Winter"};
+
+typedef struct {
+    int start_year;
+    int years;
+    double missing;
+    double skew;
+    unsigned long long seed;
+} GenConfig;
+
+// splitmix64: small, fast and good enough for synthetic weather
+static unsigned long long next_u64(unsigned long long* state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static double next_unit(unsigned long long* state) {
+    return (next_u64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double next_range(unsigned long long* state, double lo, double hi) {
+    return lo + (hi - lo) * next_unit(state);
+}
+
+static int days_in_month(int year, int month) {
+    static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return days[month] + (month == 1 && leap);
+}
+
+// Append v with `decimals` (0 or 1) fractional digits, then a comma;
+// only the comma when the field is blanked. printf is the bottleneck
+// otherwise.
+static char* put_field(char* p, double v, int decimals, int blank) {
+    if (!blank) {
+        long scaled = lround(decimals ? v * 10.0 : v);
+        if (scaled < 0) {
+            *p++ = '-';
+            scaled = -scaled;
+        }
+        long whole = decimals ? scaled / 10 : scaled;
+        char digits[24];
+        int n = 0;
+        do {
+            digits[n++] = (char)('0' + whole % 10);
+            whole /= 10;
+        } while (whole > 0);
+        while (n > 0) *p++ = digits[--n];
+        if (decimals) {
+            *p++ = '.';
+            *p++ = (char)('0' + scaled % 10);
+        }
+    }
+    *p++ = ',';
+    return p;
+}
+
+static char* put_int(char* p, int v, int width) {
+    char digits[12];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0 || n < width);
+    while (n > 0) *p++ = digits[--n];
+    return p;
+}
+
+// Write one city's file. Returns the number of data rows, or -1 on error.
+static long write_city(const char* out_dir, int city, const GenConfig* cfg) {
+    char name[64], path[1024];
+    snprintf(name, sizeof(name), "City_%04d", city);
+    snprintf(path, sizeof(path), "%s/%s.csv", out_dir, name);
+
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    char* io_buf = malloc(IO_BUFFER_SIZE);
+    if (io_buf) setvbuf(fp, io_buf, _IOFBF, IO_BUFFER_SIZE);
+    fputs(header, fp);
+
+    unsigned long long rng = cfg->seed ^ (0xD1B54A32D192ED03ULL * (unsigned long long)(city + 1));
+    unsigned long long mask = rng ^ MASK_SALT;
+
+    // Per-city climate: mean, seasonal swing, day-to-day noise, wetness
+    double mean = next_range(&rng, -12.0, 30.0);
+    double swing = next_range(&rng, 2.0, 18.0);
+    double noise = next_range(&rng, 1.5, 6.0);
+    double rain_chance = next_range(&rng, 0.05, 0.75);
+    double rain_scale = next_range(&rng, 1.0, 12.0);
+    double pressure = next_range(&rng, 1005.0, 1020.0);
+
+    // Skewed cities keep the most recent part of the span
+    int years = cfg->years;
+    if (cfg->skew > 0) {
+        years = (int)ceil(cfg->years * pow(next_unit(&mask), cfg->skew));
+        if (years < 1) years = 1;
+    }
+    int first_year = cfg->start_year + cfg->years - years;
+
+    char station[16];
+    snprintf(station, sizeof(station), "S%d,", city);
+    size_t station_len = strlen(station);
+    size_t name_len = strlen(name);
+
+    char line[256];
+    long rows = 0;
+    int day_of_year = 0;
+    for (int y = first_year; y < cfg->start_year + cfg->years; y++) {
+        for (int m = 0; m < 12; m++) {
+            for (int d = 1; d <= days_in_month(y, m); d++, day_of_year++) {
+                double phase = 2.0 * M_PI * ((day_of_year % 365) - 15) / 365.0;
+                double avg = mean - swing * cos(phase) + noise * (next_unit(&rng) + next_unit(&rng) - 1.0);
+                double spread = next_range(&rng, 2.0, 8.0);
+                double precip = next_unit(&rng) < rain_chance ? -rain_scale * log(1.0 - next_unit(&rng)) : 0.0;
+                double wind_dir = next_range(&rng, 0.0, 360.0);
+                double wind_speed = next_range(&rng, 0.0, 30.0);
+                double pres = pressure + next_range(&rng, -15.0, 15.0);
+
+                // One draw per measurement field whether or not blanking is on
+                int blank[7];
+                for (int k = 0; k < 7; k++) blank[k] = next_unit(&mask) < cfg->missing;
+
+                char* p = line;
+                memcpy(p, station, station_len);
+                p += station_len;
+                memcpy(p, name, name_len);
+                p += name_len;
+                *p++ = ',';
+                p = put_int(p, y, 4);
+                *p++ = '-';
+                p = put_int(p, m + 1, 2);
+                *p++ = '-';
+                p = put_int(p, d, 2);
+                memcpy(p, " 00:00:00,", 10);
+                p += 10;
+                size_t season_len = strlen(season_of_month[m]);
+                memcpy(p, season_of_month[m], season_len);
+                p += season_len;
+                *p++ = ',';
+                p = put_field(p, avg, 1, blank[0]);
+                p = put_field(p, avg - spread, 1, blank[1]);
+                p = put_field(p, avg + spread, 1, blank[2]);
+                p = put_field(p, precip, 1, blank[3]);
+                *p++ = ',';                                      // snow_depth_mm
+                p = put_field(p, wind_dir, 0, blank[4]);
+                p = put_field(p, wind_speed, 1, blank[5]);
+                *p++ = ',';                                      // peak_wind_gust_kmh
+                p = put_field(p, pres, 1, blank[6]);
+                *p++ = '\n';                                     // sunshine_total_min
+                fwrite(line, 1, p - line, fp);
+                rows++;
+            }
+        }
+    }
+
+    int rc = fclose(fp);
+    free(io_buf);
+    if (rc != 0) {
+        perror(path);
+        return -1;
+    }
+    return rows;
+}
+
+// mkdir -p: create dir and any missing parents. Returns 0 or -1 (errno set).
+static int make_dirs(const char* dir) {
+    char path[1024];
+    if (snprintf(path, sizeof(path), "%s", dir) >= (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    for (char* p = path + 1; ; p++) {
+        if (*p != '/' && *p != '\0') continue;
+        char c = *p;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) return -1;
+        *p = c;
+        if (c == '\0') break;
+    }
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    if (!S_ISDIR(st.st_mode)) {
+        errno = ENOTDIR;
+        return -1;
+    }
+    return 0;
+}
+
+static double get_time_sec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <out_dir> [num_cities] [years] [seed] [--start-year Y] [--missing R]\n"
+               "       [--skew S] [--threads N]\n", argv[0]);
+        printf("Example: %s data/synthetic 200 10 42 --missing 0.02 --skew 2\n", argv[0]);
+        return 1;
+    }
+
+    const char* out_dir = argv[1];
+    GenConfig cfg = {DEFAULT_START_YEAR, 10, 0.0, 0.0, 42};
+    int num_cities = 100;
+    int threads = 0;
+
+    int pos = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--start-year") == 0 && i + 1 < argc) {
+            cfg.start_year = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--missing") == 0 && i + 1 < argc) {
+            cfg.missing = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--skew") == 0 && i + 1 < argc) {
+            cfg.skew = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && pos < 3) {
+            if (pos == 0) num_cities = atoi(argv[i]);
+            else if (pos == 1) cfg.years = atoi(argv[i]);
+            else cfg.seed = strtoull(argv[i], NULL, 10);
+            pos++;
+        } else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (num_cities < 0 || cfg.years < 1 || cfg.missing < 0 || cfg.missing > 1 || cfg.skew < 0) {
+        fprintf(stderr, "Invalid arguments: need years >= 1, 0 <= missing <= 1, skew >= 0\n");
+        return 1;
+    }
+
+    if (make_dirs(out_dir) != 0) {
+        fprintf(stderr, "Cannot create output directory %s: %s\n", out_dir, strerror(errno));
+        return 1;
+    }
+#ifdef _OPENMP
+    if (threads <= 0) threads = omp_get_max_threads();
+#else
+    threads = 1;
+#endif
+
+    double start = get_time_sec();
+    long total = 0;
+    int failed = 0;
+
+    // Files are independent; dynamic scheduling absorbs skewed sizes
+    #pragma omp parallel for schedule(dynamic) num_threads(threads) reduction(+:total, failed)
+    for (int c = 0; c < num_cities; c++) {
+        long rows = write_city(out_dir, c, &cfg);
+        if (rows < 0) failed++;
+        else total += rows;
+    }
+    if (failed) return 1;
+
+    printf("Generated %d cities, %ld records in %s (seed %llu, %d-%d, missing %.3f, skew %.2f) in %.2f s\n",
+           num_cities, total, out_dir, cfg.seed, cfg.start_year, cfg.start_year + cfg.years - 1,
+           cfg.missing, cfg.skew, get_time_sec() - start);
+    return 0;
+}